@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "analyze.h"
+
+#define UNVISITED UINT32_MAX
+
+static void *analyze_alloc(size_t count, size_t size) {
+    void *ptr = calloc(count ? count : 1, size);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+// Breadth-first from the first room
+static void find_reachable(const StoryTables *t, StoryAnalysis *a) {
+    uint32_t *queue = analyze_alloc(t->room_count, sizeof(uint32_t));
+    uint32_t head = 0, tail = 0;
+
+    if (t->room_count) {
+        a->reachable[0] = 1;
+        queue[tail++] = 0;
+    }
+    while (head < tail) {
+        uint32_t r = queue[head++];
+        for (uint32_t o = t->room_first_option[r]; o < t->room_first_option[r + 1]; o++) {
+            uint32_t target = t->option_target[o];
+            if (target != STORY_NO_ROOM && !a->reachable[target]) {
+                a->reachable[target] = 1;
+                queue[tail++] = target;
+            }
+        }
+    }
+    a->unreachable_count = t->room_count - tail;
+    free(queue);
+}
+
+static void find_dead_ends(const StoryTables *t, StoryAnalysis *a) {
+    a->dead_ends = analyze_alloc(t->room_count, sizeof(uint32_t));
+    for (uint32_t r = 0; r < t->room_count; r++) {
+        if (t->room_ending[r]) continue;
+
+        uint32_t o = t->room_first_option[r];
+        while (o < t->room_first_option[r + 1] && t->option_target[o] == STORY_NO_ROOM) {
+            o++;
+        }
+        if (o == t->room_first_option[r + 1]) {
+            a->dead_ends[a->dead_end_count++] = r;
+        }
+    }
+}
+
+// Tarjan's algorithm; the recursion is an explicit stack of (room, next
+// option) frames, so its depth is bounded by the room count, not by the
+// call stack
+static void find_components(const StoryTables *t, StoryAnalysis *a) {
+    uint32_t n = t->room_count;
+    uint32_t *index = analyze_alloc(n, sizeof(uint32_t));
+    uint32_t *low = analyze_alloc(n, sizeof(uint32_t));
+    uint32_t *stack = analyze_alloc(n, sizeof(uint32_t));
+    uint32_t *frame_room = analyze_alloc(n, sizeof(uint32_t));
+    uint32_t *frame_option = analyze_alloc(n, sizeof(uint32_t));
+    uint8_t *on_stack = analyze_alloc(n, sizeof(uint8_t));
+    uint32_t next_index = 0, sp = 0, fp = 0, count = 0;
+
+    for (uint32_t r = 0; r < n; r++) index[r] = UNVISITED;
+
+    for (uint32_t root = 0; root < n; root++) {
+        if (index[root] != UNVISITED) continue;
+
+        index[root] = low[root] = next_index++;
+        stack[sp++] = root;
+        on_stack[root] = 1;
+        frame_room[fp] = root;
+        frame_option[fp++] = t->room_first_option[root];
+
+        while (fp > 0) {
+            uint32_t v = frame_room[fp - 1];
+            uint32_t o = frame_option[fp - 1];
+
+            if (o < t->room_first_option[v + 1]) {
+                frame_option[fp - 1]++;
+                uint32_t w = t->option_target[o];
+                if (w == STORY_NO_ROOM) continue;
+                if (index[w] == UNVISITED) {
+                    index[w] = low[w] = next_index++;
+                    stack[sp++] = w;
+                    on_stack[w] = 1;
+                    frame_room[fp] = w;
+                    frame_option[fp++] = t->room_first_option[w];
+                } else if (on_stack[w] && index[w] < low[v]) {
+                    low[v] = index[w];
+                }
+                continue;
+            }
+
+            // All of v's gotos are done: v either roots a component or
+            // passes its low link up to the room that entered it
+            fp--;
+            if (low[v] == index[v]) {
+                uint32_t w;
+                do {
+                    w = stack[--sp];
+                    on_stack[w] = 0;
+                    a->component[w] = count;
+                } while (w != v);
+                count++;
+            }
+            if (fp > 0 && low[v] < low[frame_room[fp - 1]]) {
+                low[frame_room[fp - 1]] = low[v];
+            }
+        }
+    }
+    a->component_count = count;
+
+    free(on_stack);
+    free(frame_option);
+    free(frame_room);
+    free(stack);
+    free(low);
+    free(index);
+}
+
+// Renumbers the components by their first room and groups the rooms of
+// each, in declaration order
+static void group_components(const StoryTables *t, StoryAnalysis *a) {
+    uint32_t n = t->room_count;
+    uint32_t *number = analyze_alloc(a->component_count, sizeof(uint32_t));
+    uint32_t next = 0;
+
+    for (uint32_t c = 0; c < a->component_count; c++) number[c] = UNVISITED;
+    for (uint32_t r = 0; r < n; r++) {
+        uint32_t *c = &number[a->component[r]];
+        if (*c == UNVISITED) *c = next++;
+        a->component[r] = *c;
+    }
+    free(number);
+
+    a->component_first = analyze_alloc(a->component_count + 1, sizeof(uint32_t));
+    a->component_rooms = analyze_alloc(n, sizeof(uint32_t));
+    for (uint32_t r = 0; r < n; r++) {
+        a->component_first[a->component[r] + 1]++;
+    }
+    for (uint32_t c = 0; c < a->component_count; c++) {
+        a->component_first[c + 1] += a->component_first[c];
+    }
+    uint32_t *fill = analyze_alloc(a->component_count, sizeof(uint32_t));
+    for (uint32_t r = 0; r < n; r++) {
+        uint32_t c = a->component[r];
+        a->component_rooms[a->component_first[c] + fill[c]++] = r;
+    }
+    free(fill);
+
+    for (uint32_t c = 0; c < a->component_count; c++) {
+        if (story_analysis_is_cycle(t, a, c)) a->cycle_count++;
+    }
+}
+
+void story_analyze(const StoryTables *tables, StoryAnalysis *analysis) {
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->room_count = tables->room_count;
+    analysis->reachable = analyze_alloc(tables->room_count, sizeof(uint8_t));
+    analysis->component = analyze_alloc(tables->room_count, sizeof(uint32_t));
+
+    find_reachable(tables, analysis);
+    find_dead_ends(tables, analysis);
+    find_components(tables, analysis);
+    group_components(tables, analysis);
+}
+
+void story_analysis_free(StoryAnalysis *analysis) {
+    free(analysis->reachable);
+    free(analysis->dead_ends);
+    free(analysis->component);
+    free(analysis->component_rooms);
+    free(analysis->component_first);
+    memset(analysis, 0, sizeof(*analysis));
+}
+
+int story_analysis_is_cycle(const StoryTables *tables, const StoryAnalysis *analysis,
+                            uint32_t c) {
+    uint32_t first = analysis->component_first[c];
+    if (analysis->component_first[c + 1] - first > 1) return 1;
+
+    // A single room is a cycle only if it leads back to itself
+    uint32_t r = analysis->component_rooms[first];
+    for (uint32_t o = tables->room_first_option[r]; o < tables->room_first_option[r + 1]; o++) {
+        if (tables->option_target[o] == r) return 1;
+    }
+    return 0;
+}
+
+uint32_t story_analysis_print(const StoryTables *t, const StoryAnalysis *a, FILE *stream) {
+    fprintf(stream, "\n===== ANALYSIS =====\n");
+    if (t->room_count == 0) {
+        fprintf(stream, "No rooms defined\n");
+    } else {
+        fprintf(stream, "Rooms: %u, reachable from %s: %u\n", t->room_count,
+                story_string(t, t->room_name[0]), t->room_count - a->unreachable_count);
+    }
+
+    fprintf(stream, "\n--- UNREACHABLE ROOMS (%u) ---\n", a->unreachable_count);
+    for (uint32_t r = 0; r < t->room_count; r++) {
+        if (!a->reachable[r]) fprintf(stream, "%s\n", story_string(t, t->room_name[r]));
+    }
+
+    fprintf(stream, "\n--- DEAD ENDS (%u) ---\n", a->dead_end_count);
+    for (uint32_t i = 0; i < a->dead_end_count; i++) {
+        fprintf(stream, "%s\n", story_string(t, t->room_name[a->dead_ends[i]]));
+    }
+
+    fprintf(stream, "\n--- CYCLES (%u) ---\n", a->cycle_count);
+    for (uint32_t c = 0; c < a->component_count; c++) {
+        if (!story_analysis_is_cycle(t, a, c)) continue;
+        for (uint32_t i = a->component_first[c]; i < a->component_first[c + 1]; i++) {
+            fprintf(stream, i > a->component_first[c] ? ", %s" : "%s",
+                    story_string(t, t->room_name[a->component_rooms[i]]));
+        }
+        fprintf(stream, "\n");
+    }
+
+    fprintf(stream, "\n================\n");
+    return a->unreachable_count + a->dead_end_count;
+}
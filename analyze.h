@@ -0,0 +1,48 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "story.h"
+
+/*
+ * Graph analysis of a finished story, run on its tables: a room's options
+ * are one contiguous range, so the rooms and their gotos already form an
+ * adjacency array and every pass below is O(rooms + options).
+ *
+ * - reachability: which rooms can be entered from the first room
+ * - dead ends: rooms with no way out (no options, or only dangling ones)
+ *   that are not declared with "ending;"
+ * - strongly connected components (Tarjan's algorithm, with an explicit
+ *   stack so deep stories cannot overflow the call stack); components of
+ *   more than one room, or one room that leads to itself, are cycles
+ */
+
+typedef struct StoryAnalysis {
+    uint32_t room_count;
+    uint8_t *reachable;           // per room: 1 if reachable from room 0
+    uint32_t unreachable_count;
+    uint32_t *dead_ends;          // room indices, in declaration order
+    uint32_t dead_end_count;
+    uint32_t *component;          // per room: its component's number
+    uint32_t component_count;
+    uint32_t *component_rooms;    // rooms grouped by component
+    uint32_t *component_first;    // component_count + 1 range starts
+    uint32_t cycle_count;         // components that are cycles
+} StoryAnalysis;
+
+void story_analyze(const StoryTables *tables, StoryAnalysis *analysis);
+void story_analysis_free(StoryAnalysis *analysis);
+
+/* True if component `c` is a cycle */
+int story_analysis_is_cycle(const StoryTables *tables, const StoryAnalysis *analysis,
+                            uint32_t c);
+
+/*
+ * Writes the findings as a listing to `stream`. Returns the number of
+ * problems (unreachable rooms and dead ends); cycles are not problems.
+ */
+uint32_t story_analysis_print(const StoryTables *tables, const StoryAnalysis *analysis,
+                              FILE *stream);
+
+#endif /* ANALYZE_H */
@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "source.h"
+#include "story.h"
+#include "storyscript.h"
+
+struct StoryScript {
+    StoryParseCtx ctx;        // kept from the parse to the link
+    char *filename;           // what ctx.filename points to
+    FILE *capture;            // ctx.diag.err, writing to messages
+    char *messages;
+    size_t messages_len;
+    int parsed;
+    int linked;
+};
+
+int storyscript_api_version(void) {
+    return STORYSCRIPT_API_VERSION;
+}
+
+StoryScript *storyscript_new(void) {
+    StoryScript *story = (StoryScript *)calloc(1, sizeof(StoryScript));
+    if (!story) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    story->capture = open_memstream(&story->messages, &story->messages_len);
+    if (!story->capture) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    // Parse only: includes and gotos wait for storyscript_link()
+    story_parse_ctx_init(&story->ctx, NULL);
+    diag_free(&story->ctx.diag);
+    diag_init(&story->ctx.diag, DIAG_ERROR, NULL, story->capture);
+    story->ctx.module = 1;
+    return story;
+}
+
+void storyscript_free(StoryScript *story) {
+    if (!story) return;
+    free_story(story->ctx.story);
+    story_parse_ctx_free(&story->ctx);
+    fclose(story->capture);
+    free(story->messages);
+    free(story->filename);
+    free(story);
+}
+
+void storyscript_set_jobs(StoryScript *story, int jobs) {
+    story->ctx.jobs = jobs;
+}
+
+void storyscript_set_max_errors(StoryScript *story, int max_errors) {
+    story->ctx.max_errors = max_errors;
+}
+
+static void set_filename(StoryScript *story, const char *name) {
+    story->filename = strdup(name);
+    if (!story->filename) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    story->ctx.filename = story->filename;
+}
+
+static int parse(StoryScript *story, SourceBuffer *source) {
+    story->parsed = 1;
+    if (storyscript_parse_source(source, &story->ctx) != 0 && story->ctx.errors == 0) {
+        story->ctx.errors = 1;
+    }
+    return story->ctx.errors;
+}
+
+int storyscript_parse_file(StoryScript *story, const char *path) {
+    if (story->parsed) return -1;
+
+    // Regular files are mapped, anything else is read through stdio
+    SourceBuffer source;
+    source_init(&source);
+    if (source_map_file(&source, path) != 0) {
+        FILE *input = fopen(path, "r");
+        int result = input ? source_read_stream(&source, input) : -1;
+        if (input) fclose(input);
+        if (result != 0) {
+            source_release(&source);
+            DIAG(&story->ctx.diag, DIAG_ERROR, "Error: Cannot open file '%s'\n", path);
+            diag_flush(&story->ctx.diag);
+            return -1;
+        }
+    }
+    set_filename(story, path);
+    return parse(story, &source);
+}
+
+int storyscript_parse_text(StoryScript *story, const char *text, size_t len, const char *name) {
+    if (story->parsed) return -1;
+
+    SourceBuffer source;
+    source_init(&source);
+    source_copy(&source, text, len);
+    set_filename(story, name ? name : "<text>");
+    return parse(story, &source);
+}
+
+int storyscript_link(StoryScript *story) {
+    if (!story->parsed) return -1;
+    if (!story->linked) {
+        story->linked = 1;
+        storyscript_finish_parse(&story->ctx);
+    }
+    return story->ctx.errors;
+}
+
+int storyscript_errors(const StoryScript *story) {
+    return story->ctx.errors;
+}
+
+const char *storyscript_messages(StoryScript *story) {
+    fflush(story->capture);
+    return story->messages ? story->messages : "";
+}
+
+// The tables, once there are any
+static const StoryTables *linked_tables(const StoryScript *story) {
+    return story->linked ? &story->ctx.story->tables : NULL;
+}
+
+// Index in the tables of choice `choice` of `room`, or STORYSCRIPT_NONE
+static uint32_t choice_index(const StoryTables *t, uint32_t room, uint32_t choice) {
+    if (!t || room >= t->room_count) return STORYSCRIPT_NONE;
+    uint32_t first = t->room_first_choice[room];
+    return choice < t->room_first_choice[room + 1] - first ? first + choice : STORYSCRIPT_NONE;
+}
+
+static uint32_t option_index(const StoryTables *t, uint32_t room, uint32_t choice,
+                             uint32_t option) {
+    uint32_t c = choice_index(t, room, choice);
+    if (c == STORYSCRIPT_NONE) return STORYSCRIPT_NONE;
+    uint32_t first = t->choice_first_option[c];
+    return option < t->choice_first_option[c + 1] - first ? first + option : STORYSCRIPT_NONE;
+}
+
+const char *storyscript_title(const StoryScript *story) {
+    return story->ctx.story ? story->ctx.story->title : NULL;
+}
+
+uint32_t storyscript_room_count(const StoryScript *story) {
+    const StoryTables *t = linked_tables(story);
+    return t ? t->room_count : 0;
+}
+
+const char *storyscript_room_name(const StoryScript *story, uint32_t room) {
+    const StoryTables *t = linked_tables(story);
+    return t && room < t->room_count ? story_string(t, t->room_name[room]) : NULL;
+}
+
+const char *storyscript_room_description(const StoryScript *story, uint32_t room) {
+    const StoryTables *t = linked_tables(story);
+    return t && room < t->room_count ? story_string(t, t->room_description[room]) : NULL;
+}
+
+int storyscript_room_is_ending(const StoryScript *story, uint32_t room) {
+    const StoryTables *t = linked_tables(story);
+    return t && room < t->room_count ? t->room_ending[room] : 0;
+}
+
+uint32_t storyscript_choice_count(const StoryScript *story, uint32_t room) {
+    const StoryTables *t = linked_tables(story);
+    return t && room < t->room_count ? t->room_first_choice[room + 1] - t->room_first_choice[room] : 0;
+}
+
+const char *storyscript_choice_text(const StoryScript *story, uint32_t room, uint32_t choice) {
+    const StoryTables *t = linked_tables(story);
+    uint32_t c = choice_index(t, room, choice);
+    return c != STORYSCRIPT_NONE ? story_string(t, t->choice_text[c]) : NULL;
+}
+
+uint32_t storyscript_option_count(const StoryScript *story, uint32_t room, uint32_t choice) {
+    const StoryTables *t = linked_tables(story);
+    uint32_t c = choice_index(t, room, choice);
+    return c != STORYSCRIPT_NONE ? t->choice_first_option[c + 1] - t->choice_first_option[c] : 0;
+}
+
+const char *storyscript_option_text(const StoryScript *story, uint32_t room, uint32_t choice,
+                                    uint32_t option) {
+    const StoryTables *t = linked_tables(story);
+    uint32_t o = option_index(t, room, choice, option);
+    return o != STORYSCRIPT_NONE ? story_string(t, t->option_text[o]) : NULL;
+}
+
+const char *storyscript_option_target_name(const StoryScript *story, uint32_t room,
+                                           uint32_t choice, uint32_t option) {
+    const StoryTables *t = linked_tables(story);
+    uint32_t o = option_index(t, room, choice, option);
+    return o != STORYSCRIPT_NONE ? story_string(t, t->option_target_name[o]) : NULL;
+}
+
+uint32_t storyscript_option_target(const StoryScript *story, uint32_t room, uint32_t choice,
+                                   uint32_t option) {
+    const StoryTables *t = linked_tables(story);
+    uint32_t o = option_index(t, room, choice, option);
+    return o != STORYSCRIPT_NONE ? t->option_target[o] : STORYSCRIPT_NONE;
+}
+
+uint32_t storyscript_item_count(const StoryScript *story) {
+    const StoryTables *t = linked_tables(story);
+    return t ? t->item_count : 0;
+}
+
+const char *storyscript_item_name(const StoryScript *story, uint32_t item) {
+    const StoryTables *t = linked_tables(story);
+    return t && item < t->item_count ? story_string(t, t->item_name[item]) : NULL;
+}
+
+const char *storyscript_item_description(const StoryScript *story, uint32_t item) {
+    const StoryTables *t = linked_tables(story);
+    return t && item < t->item_count ? story_string(t, t->item_description[item]) : NULL;
+}
+
+uint32_t storyscript_find_item(const StoryScript *story, const char *name) {
+    const StoryTables *t = linked_tables(story);
+    return t ? story_find_item(t, name) : STORYSCRIPT_NONE;
+}
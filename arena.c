@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "arena.h"
+#include "stats.h"
+
+#define ARENA_FIRST_CHUNK (16 * 1024)
+#define ARENA_MAX_CHUNK   (4 * 1024 * 1024)
+
+// Every allocation is rounded up to this so nodes stay properly aligned
+#define ARENA_ALIGN _Alignof(max_align_t)
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct ArenaChunk {
+    ArenaChunk *next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+};
+
+static ArenaChunk *arena_new_chunk(size_t size) {
+    ArenaChunk *chunk = (ArenaChunk *)malloc(sizeof(ArenaChunk) + size);
+    if (!chunk) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    chunk->size = size;
+    chunk->used = 0;
+    STATS_ADD(arena_chunks, 1);
+    return chunk;
+}
+
+void arena_init(Arena *arena) {
+    arena->chunks = NULL;
+    arena->next_size = ARENA_FIRST_CHUNK;
+}
+
+void arena_free(Arena *arena) {
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk) {
+        ArenaChunk *next_chunk = chunk->next;
+        free(chunk);
+        chunk = next_chunk;
+    }
+    arena_init(arena);
+}
+
+void arena_reset(Arena *arena) {
+#ifdef ARENA_USE_MALLOC
+    arena_free(arena);
+#else
+    ArenaChunk *keep = arena->chunks;
+    if (!keep) return;
+
+    ArenaChunk *chunk = keep->next;
+    while (chunk) {
+        ArenaChunk *next_chunk = chunk->next;
+        free(chunk);
+        chunk = next_chunk;
+    }
+    keep->next = NULL;
+    keep->used = 0;
+#endif
+}
+
+#ifdef ARENA_USE_MALLOC
+
+// Debug mode: one block per allocation, chained so arena_free() finds them
+void *arena_alloc(Arena *arena, size_t size) {
+    STATS_ADD(arena_allocs, 1);
+    STATS_ADD(arena_bytes, size);
+    ArenaChunk *chunk = arena_new_chunk(size);
+    chunk->used = size;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    return chunk->data;
+}
+
+#else
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = ARENA_ROUND(size);
+    STATS_ADD(arena_allocs, 1);
+    STATS_ADD(arena_bytes, size);
+
+    ArenaChunk *chunk = arena->chunks;
+    if (!chunk || chunk->size - chunk->used < size) {
+        size_t chunk_size = arena->next_size;
+        if (arena->next_size < ARENA_MAX_CHUNK) {
+            arena->next_size *= 2;
+        }
+
+        // Oversized requests get a chunk of their own behind the current one
+        // so the space left in the current chunk is not thrown away
+        if (size > chunk_size) {
+            ArenaChunk *big = arena_new_chunk(size);
+            big->used = size;
+            if (chunk) {
+                big->next = chunk->next;
+                chunk->next = big;
+            } else {
+                big->next = NULL;
+                arena->chunks = big;
+            }
+            return big->data;
+        }
+
+        chunk = arena_new_chunk(chunk_size);
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+
+    void *ptr = (char *)chunk->data + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+#endif /* ARENA_USE_MALLOC */
+
+char *arena_strndup(Arena *arena, const char *s, size_t len) {
+    char *copy = (char *)arena_alloc(arena, len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char *arena_strdup(Arena *arena, const char *s) {
+    return arena_strndup(arena, s, strlen(s));
+}
@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Bump allocator that owns every node and string of a Story.
+ *
+ * Memory is carved out of chunks that double in size as the arena grows,
+ * and is only ever released all at once by arena_free(), so tearing down a
+ * story costs one free() per chunk instead of one per node.
+ *
+ * Building with -DARENA_USE_MALLOC turns every allocation into its own
+ * malloc() block (still released by arena_free()), which lets ASan and
+ * valgrind see the bounds of each node.
+ */
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct Arena {
+    ArenaChunk *chunks;   // most recent chunk first
+    size_t next_size;     // size of the next chunk to allocate
+} Arena;
+
+void arena_init(Arena *arena);
+void arena_free(Arena *arena);
+
+/* Releases everything allocated so far but keeps the newest chunk for reuse */
+void arena_reset(Arena *arena);
+
+/* Memory is not zeroed; exits on allocation failure like the rest of the parser */
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strdup(Arena *arena, const char *s);
+char *arena_strndup(Arena *arena, const char *s, size_t len);
+
+#endif /* ARENA_H */
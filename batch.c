@@ -0,0 +1,126 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include "batch.h"
+#include "story.h"
+#include "threadpool.h"
+
+typedef struct BatchFile {
+    char *path;
+    int errors;
+    char *diagnostics;   // everything the parse wrote to its error stream
+    size_t diagnostics_len;
+} BatchFile;
+
+typedef struct Batch {
+    BatchFile *files;
+    size_t count;
+    size_t capacity;
+    int max_errors;
+} Batch;
+
+// nftw() has no user pointer, and directory walking happens on one thread
+static Batch *walk_batch;
+
+static int is_story_file(const char *path) {
+    size_t len = strlen(path);
+    return len > 6 && strcmp(path + len - 6, ".story") == 0;
+}
+
+static int collect_file(const char *path, const struct stat *st, int type,
+                        struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    if (type != FTW_F || !is_story_file(path)) return 0;
+
+    Batch *batch = walk_batch;
+    if (batch->count == batch->capacity) {
+        batch->capacity = batch->capacity ? batch->capacity * 2 : 64;
+        batch->files = (BatchFile *)realloc(batch->files,
+                                            batch->capacity * sizeof(BatchFile));
+        if (!batch->files) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+    }
+
+    BatchFile *file = &batch->files[batch->count++];
+    file->path = strdup(path);
+    file->errors = 0;
+    file->diagnostics = NULL;
+    file->diagnostics_len = 0;
+    return 0;
+}
+
+static int compare_files(const void *a, const void *b) {
+    return strcmp(((const BatchFile *)a)->path, ((const BatchFile *)b)->path);
+}
+
+static void check_file(size_t index, void *arg) {
+    Batch *batch = (Batch *)arg;
+    BatchFile *file = &batch->files[index];
+
+    // Diagnostics are captured per file and printed later, in order
+    FILE *err = open_memstream(&file->diagnostics, &file->diagnostics_len);
+    if (!err) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    SourceBuffer source;
+    source_init(&source);
+    if (source_map_file(&source, file->path) != 0) {
+        fprintf(err, "Error: Cannot open file '%s'\n", file->path);
+        file->errors = 1;
+        fclose(err);
+        return;
+    }
+
+    StoryParseCtx ctx;
+    story_parse_ctx_init(&ctx, file->path);
+    ctx.diag.level = DIAG_ERROR;
+    ctx.jobs = 1;   // the pool is already busy with other files
+    ctx.max_errors = batch->max_errors;
+    ctx.diag.out = NULL;
+    ctx.diag.err = err;
+    if (storyscript_parse_source(&source, &ctx) != 0 && ctx.errors == 0) {
+        ctx.errors = 1;
+    }
+    file->errors = ctx.errors;
+
+    free_story(ctx.story);
+    story_parse_ctx_free(&ctx);
+    fclose(err);
+}
+
+int batch_check(const char *dir, int jobs, int max_errors) {
+    Batch batch = { NULL, 0, 0, max_errors };
+
+    walk_batch = &batch;
+    if (nftw(dir, collect_file, 32, FTW_PHYS) != 0) {
+        fprintf(stderr, "Error: Cannot read directory '%s'\n", dir);
+        walk_batch = NULL;
+        return 1;
+    }
+    walk_batch = NULL;
+    qsort(batch.files, batch.count, sizeof(BatchFile), compare_files);
+
+    threadpool_run(batch.count, jobs, check_file, &batch);
+
+    int failed = 0;
+    for (size_t i = 0; i < batch.count; i++) {
+        BatchFile *file = &batch.files[i];
+        if (file->diagnostics_len) {
+            fwrite(file->diagnostics, 1, file->diagnostics_len, stderr);
+        }
+        if (file->errors) failed++;
+        free(file->diagnostics);
+        free(file->path);
+    }
+    free(batch.files);
+
+    printf("Checked %zu files: %d with errors\n", batch.count, failed);
+    return failed;
+}
@@ -0,0 +1,12 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/*
+ * Batch checking: parses every .story file under `dir` on `jobs` threads
+ * and prints each file's diagnostics in path order, so the output does not
+ * depend on scheduling. Each file stops after `max_errors` errors (0 for
+ * no limit). Returns the number of files that had errors.
+ */
+int batch_check(const char *dir, int jobs, int max_errors);
+
+#endif /* BATCH_H */
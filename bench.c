@@ -0,0 +1,317 @@
+/*
+ * Parser benchmark.
+ *
+ * Runs each phase of loading a story on its own, several times, and keeps
+ * the best time of each: lexing alone, the full parse (which includes the
+ * link pass and building the tables), the link pass again on its own,
+ * the graph analysis of the finished tables, random walks of many play
+ * sessions through the runtime (a call per step, then a batch per tick),
+ * re-parsing one room in the middle of the story as an editor would,
+ * free_story(), and an event parse that only counts rooms. Input is
+ * mapped the same way the storyscript binary maps it, so page cache
+ * effects match real runs.
+ *
+ * -o writes the best times to a file and -b reads such a file back, so a
+ * run of one build (release, pgo) reports its speed-up over another (the
+ * debug build) phase by phase. -l times the lexer alone, for comparing
+ * builds that differ only in their flex tables.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "analyze.h"
+#include "runtime.h"
+#include "story.h"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n runs] [-l] [-o times] [-b baseline-times] file.story\n", prog);
+}
+
+#define BENCH_MAX_PHASES 16
+
+// Best times of the build compared against, by phase
+static struct { char phase[16]; double seconds; } baseline[BENCH_MAX_PHASES];
+static int baseline_count;
+static FILE *times_out;   // where this run's best times go, or NULL
+
+static FILE *open_file(const char *path, const char *mode) {
+    FILE *file = fopen(path, mode);
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", path);
+        exit(1);
+    }
+    return file;
+}
+
+// Lines of "<seconds> <phase>", as -o writes them
+static void load_baseline(const char *path) {
+    FILE *in = open_file(path, "r");
+    char line[64];
+    while (baseline_count < BENCH_MAX_PHASES && fgets(line, sizeof(line), in)) {
+        if (sscanf(line, "%lf %15[^\n]", &baseline[baseline_count].seconds,
+                   baseline[baseline_count].phase) == 2) {
+            baseline_count++;
+        }
+    }
+    fclose(in);
+}
+
+// Prints the time of `phase` and its speed-up over the baseline, and saves it
+static void report_time(const char *phase, double seconds) {
+    printf("  %-12s %10.3f ms", phase, seconds * 1e3);
+    for (int i = 0; i < baseline_count; i++) {
+        if (strcmp(baseline[i].phase, phase) == 0) {
+            printf("  %6.2fx", baseline[i].seconds / seconds);
+            break;
+        }
+    }
+    if (times_out) {
+        fprintf(times_out, "%.9f %s\n", seconds, phase);
+    }
+}
+
+static void load(SourceBuffer *source, const char *path) {
+    source_init(source);
+    if (source_map_file(source, path) != 0) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", path);
+        exit(1);
+    }
+}
+
+static void count_room(void *user, const char *name, const char *description) {
+    (void)name;
+    (void)description;
+    (*(unsigned *)user)++;
+}
+
+#define BENCH_SESSIONS 100000
+#define BENCH_TICKS 100
+
+// Steps BENCH_SESSIONS sessions for BENCH_TICKS ticks, each tick giving
+// every session a random option (some of them out of range, which do not
+// move), one call per session or one story_step_batch() per tick. Options
+// are drawn one tick at a time, untimed, so the input adds little to the
+// peak RSS the benchmark reports.
+static double walk_sessions(const StoryTables *tables, int batch) {
+    StoryRuntime runtime;
+    story_runtime_init(&runtime, tables);
+
+    StorySession *sessions = (StorySession *)malloc(BENCH_SESSIONS * sizeof(StorySession));
+    uint32_t *options = (uint32_t *)malloc(BENCH_SESSIONS * sizeof(uint32_t));
+    if (!sessions || !options) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < BENCH_SESSIONS; i++) {
+        story_session_start(&runtime, &sessions[i]);
+    }
+
+    uint32_t seed = 2463534242u;
+    double elapsed = 0;
+    for (int tick = 0; tick < BENCH_TICKS; tick++) {
+        for (int i = 0; i < BENCH_SESSIONS; i++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            options[i] = seed % 16;
+        }
+
+        double start = now();
+        if (batch) {
+            story_step_batch(&runtime, sessions, options, BENCH_SESSIONS);
+        } else {
+            for (int i = 0; i < BENCH_SESSIONS; i++) {
+                story_session_take(&runtime, &sessions[i], options[i]);
+            }
+        }
+        elapsed += now() - start;
+    }
+
+    free(options);
+    free(sessions);
+    return elapsed;
+}
+
+static void report(const char *phase, double seconds, long tokens, size_t bytes) {
+    report_time(phase, seconds);
+    if (tokens > 0) {
+        printf("  %8.2f Mtok/s  %8.1f MB/s", tokens / seconds / 1e6, bytes / seconds / 1e6);
+    }
+    printf("\n");
+}
+
+static void report_steps(const char *phase, double seconds) {
+    report_time(phase, seconds);
+    printf("  %8.2f Msteps/s\n", (double)BENCH_TICKS * BENCH_SESSIONS / seconds / 1e6);
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    const char *times_path = NULL, *baseline_path = NULL;
+    int runs = 5;
+    int lex_only = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0) {
+            lex_only = 1;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            times_path = argv[++i];
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (!path) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!path || runs < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (baseline_path) load_baseline(baseline_path);
+
+    double best_lex = 1e30, best_parse = 1e30, best_link = 1e30, best_free = 1e30;
+    double best_reparse = 1e30, best_events = 1e30, best_analyze = 1e30;
+    double best_walk = 1e30, best_batch = 1e30;
+    long tokens = 0;
+    size_t bytes = 0;
+    unsigned rooms = 0, choices = 0, options = 0;
+
+    for (int run = 0; run < runs; run++) {
+        SourceBuffer source;
+        StoryParseCtx ctx;
+        story_parse_ctx_init(&ctx, path);
+        ctx.diag.level = DIAG_ERROR;
+
+        // Lexer only
+        load(&source, path);
+        bytes = source.len;
+        double start = now();
+        tokens = storyscript_count_tokens(&source, &ctx);
+        double elapsed = now() - start;
+        if (elapsed < best_lex) best_lex = elapsed;
+        free_story(ctx.story);
+        if (lex_only) {
+            story_parse_ctx_free(&ctx);
+            continue;
+        }
+
+        // Full parse
+        load(&source, path);
+        start = now();
+        if (storyscript_parse_source(&source, &ctx) != 0) {
+            fprintf(stderr, "Error: Benchmark input '%s' does not parse cleanly\n", path);
+            return 1;
+        }
+        elapsed = now() - start;
+        if (elapsed < best_parse) best_parse = elapsed;
+
+        // Link pass on its own; it only rewrites what it resolved before
+        start = now();
+        story_link(&ctx);
+        elapsed = now() - start;
+        if (elapsed < best_link) best_link = elapsed;
+
+        StoryAnalysis analysis;
+        start = now();
+        story_analyze(&ctx.story->tables, &analysis);
+        elapsed = now() - start;
+        if (elapsed < best_analyze) best_analyze = elapsed;
+        story_analysis_free(&analysis);
+
+        elapsed = walk_sessions(&ctx.story->tables, 0);
+        if (elapsed < best_walk) best_walk = elapsed;
+        elapsed = walk_sessions(&ctx.story->tables, 1);
+        if (elapsed < best_batch) best_batch = elapsed;
+
+        // One room again, from a fresh mapping since parsing changes the text
+        Room *room = ctx.story->rooms;
+        for (unsigned i = 0; room && i < ctx.story->room_count / 2; i++) {
+            room = room->next;
+        }
+        if (room) {
+            SourceBuffer pristine;
+            load(&pristine, path);
+            start = now();
+            if (storyscript_reparse_room(&ctx, room, pristine.data + room->source_start,
+                                         room->source_end - room->source_start) != 0) {
+                fprintf(stderr, "Error: Cannot re-parse room '%s'\n", room->name);
+                return 1;
+            }
+            elapsed = now() - start;
+            if (elapsed < best_reparse) best_reparse = elapsed;
+            source_release(&pristine);
+        }
+
+        rooms = ctx.story->room_count;
+        choices = ctx.story->choice_count;
+        options = ctx.story->option_count;
+
+        start = now();
+        free_story(ctx.story);
+        elapsed = now() - start;
+        if (elapsed < best_free) best_free = elapsed;
+
+        // Events only: nothing is kept, so memory stays flat
+        FILE *in = fopen(path, "r");
+        if (!in) {
+            fprintf(stderr, "Error: Cannot open file '%s'\n", path);
+            return 1;
+        }
+        unsigned counted = 0;
+        StoryEvents events = { 0 };
+        events.on_room = count_room;
+        events.user = &counted;
+        start = now();
+        storyscript_parse_events(in, &events, &ctx);
+        elapsed = now() - start;
+        if (elapsed < best_events) best_events = elapsed;
+        fclose(in);
+        if (counted != rooms) {
+            fprintf(stderr, "Error: Event parse saw %u rooms, not %u\n", counted, rooms);
+            return 1;
+        }
+
+        story_parse_ctx_free(&ctx);
+    }
+
+    struct rusage usage_info;
+    getrusage(RUSAGE_SELF, &usage_info);
+
+    if (lex_only) {
+        printf("%s: %.1f MB, %ld tokens; lexer only, best of %d runs\n",
+               path, bytes / 1e6, tokens, runs);
+    } else {
+        printf("%s: %.1f MB, %ld tokens, %u rooms, %u choices, %u options; best of %d runs\n",
+               path, bytes / 1e6, tokens, rooms, choices, options, runs);
+    }
+    if (baseline_path) printf("  (speed-ups over %s)\n", baseline_path);
+    if (times_path) times_out = open_file(times_path, "w");
+    report("lex", best_lex, tokens, bytes);
+    if (lex_only) {
+        if (times_out) fclose(times_out);
+        return 0;
+    }
+    report("parse", best_parse, tokens, bytes);
+    report("link", best_link, 0, 0);
+    report("analyze", best_analyze, 0, 0);
+    report_steps("play steps", best_walk);
+    report_steps("batch steps", best_batch);
+    if (best_reparse < 1e30) report("reparse room", best_reparse, 0, 0);
+    report("free", best_free, 0, 0);
+    report("events", best_events, tokens, bytes);
+    printf("  peak RSS     %10ld KB\n", usage_info.ru_maxrss);
+    if (times_out) fclose(times_out);
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "hash.h"
+#include "source.h"
+
+typedef struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;          // repeated, in case the file was renamed
+    uint64_t text_len;     // a second check against hash collisions
+    uint32_t failed;
+    uint32_t image_version;
+    uint64_t notes_len;    // followed by the notes, the errors and the image
+    uint64_t errors_len;
+    uint64_t image_len;
+    uint64_t payload_hash; // of everything after the header
+} CacheHeader;
+
+uint64_t story_cache_key(const char *text, size_t len, const char *filename,
+                         DiagLevel level, int max_errors) {
+    uint64_t seed = (uint64_t)STORY_CACHE_VERSION << 32 |
+                    (uint64_t)STORY_IMAGE_VERSION << 8 | (uint64_t)level;
+    seed = hash_xxh64(&max_errors, sizeof(max_errors), seed);
+    seed = hash_xxh64(filename, strlen(filename), seed);
+    return hash_xxh64(text, len, seed);
+}
+
+static char *entry_path(const char *dir, uint64_t key) {
+    size_t len = strlen(dir) + 24;
+    char *path = (char *)malloc(len);
+    if (!path) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    snprintf(path, len, "%s/%016llx.cache", dir, (unsigned long long)key);
+    return path;
+}
+
+static char *cache_alloc(size_t size) {
+    char *ptr = (char *)malloc(size ? size : 1);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+// Chained over the status and the three parts, which are read into
+// separate blocks
+static uint64_t payload_hash(uint32_t failed, const char *notes, size_t notes_len,
+                             const char *errors, size_t errors_len,
+                             const char *image, size_t image_len) {
+    uint64_t h = hash_xxh64(notes, notes_len, failed);
+    h = hash_xxh64(errors, errors_len, h);
+    return hash_xxh64(image, image_len, h);
+}
+
+static int read_exact(FILE *file, char *data, size_t len) {
+    return fread(data, 1, len, file) == len ? 0 : -1;
+}
+
+int story_cache_lookup(const char *dir, uint64_t key, size_t text_len,
+                       StoryCacheEntry *entry) {
+    memset(entry, 0, sizeof(*entry));
+
+    char *path = entry_path(dir, key);
+    FILE *file = fopen(path, "rb");
+    free(path);
+    if (!file) return -1;
+
+    // The sizes must add up to the file, so a truncated entry is a miss
+    CacheHeader header;
+    struct stat st;
+    if (read_exact(file, (char *)&header, sizeof(header)) != 0 ||
+        fstat(fileno(file), &st) != 0 ||
+        memcmp(header.magic, STORY_CACHE_MAGIC, 4) != 0 ||
+        header.version != STORY_CACHE_VERSION ||
+        header.image_version != STORY_IMAGE_VERSION ||
+        header.key != key || header.text_len != text_len ||
+        header.notes_len > (uint64_t)st.st_size ||
+        header.errors_len > (uint64_t)st.st_size ||
+        header.image_len > (uint64_t)st.st_size ||
+        sizeof(header) + header.notes_len + header.errors_len + header.image_len !=
+            (uint64_t)st.st_size) {
+        fclose(file);
+        return -1;
+    }
+
+    entry->failed = (int)header.failed;
+    entry->notes_len = header.notes_len;
+    entry->errors_len = header.errors_len;
+    entry->notes = cache_alloc(entry->notes_len);
+    entry->errors = cache_alloc(entry->errors_len);
+    char *image = cache_alloc(header.image_len);
+
+    int result = -1;
+    if (read_exact(file, entry->notes, entry->notes_len) == 0 &&
+        read_exact(file, entry->errors, entry->errors_len) == 0 &&
+        read_exact(file, image, header.image_len) == 0 &&
+        payload_hash(header.failed, entry->notes, entry->notes_len, entry->errors,
+                     entry->errors_len, image, header.image_len) == header.payload_hash) {
+        // The image takes the block over, even when it rejects it
+        result = story_image_from_buffer(&entry->image, image, header.image_len) == 0 ? 0 : -1;
+    } else {
+        free(image);
+    }
+    fclose(file);
+
+    if (result != 0) story_cache_entry_free(entry);
+    return result;
+}
+
+int story_cache_store(const char *dir, uint64_t key, size_t text_len,
+                      const StoryCacheEntry *result, const StrBuf *image) {
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Warning: Cannot create cache directory '%s'\n", dir);
+        return -1;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STORY_CACHE_MAGIC, 4);
+    header.version = STORY_CACHE_VERSION;
+    header.key = key;
+    header.text_len = text_len;
+    header.failed = (uint32_t)result->failed;
+    header.image_version = STORY_IMAGE_VERSION;
+    header.notes_len = result->notes_len;
+    header.errors_len = result->errors_len;
+    header.image_len = image->len;
+    header.payload_hash = payload_hash(header.failed, result->notes, result->notes_len,
+                                       result->errors, result->errors_len,
+                                       image->data, image->len);
+
+    StrBuf out;
+    strbuf_init(&out);
+    strbuf_append(&out, (const char *)&header, sizeof(header));
+    strbuf_append(&out, result->notes, result->notes_len);
+    strbuf_append(&out, result->errors, result->errors_len);
+    strbuf_append(&out, image->data, image->len);
+
+    char *path = entry_path(dir, key);
+    int status = write_file_atomic(path, out.data, out.len);
+    if (status != 0) {
+        fprintf(stderr, "Warning: Cannot write cache entry '%s'\n", path);
+    }
+
+    free(path);
+    strbuf_free(&out);
+    return status;
+}
+
+void story_cache_entry_free(StoryCacheEntry *entry) {
+    free(entry->notes);
+    free(entry->errors);
+    if (entry->image.data) story_image_close(&entry->image);
+    memset(entry, 0, sizeof(*entry));
+}
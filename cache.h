@@ -0,0 +1,51 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "diag.h"
+#include "image.h"
+#include "strbuf.h"
+
+/*
+ * Parse cache: a directory of entries named after a hash of the story
+ * text, each holding the compiled image of that text and the messages its
+ * parse printed. On a hit the driver replays the messages and works from
+ * the image, so unchanged files are neither lexed nor parsed again.
+ *
+ * The key also covers the file name, the message level and the error cap,
+ * since they all show up in the messages. Entries are written atomically and checked when
+ * read, so concurrent runs can share a directory and a damaged entry is
+ * just a miss.
+ */
+
+#define STORY_CACHE_MAGIC "STYK"
+#define STORY_CACHE_VERSION 5   // bump whenever parsing changes its messages
+
+typedef struct StoryCacheEntry {
+    int failed;           // what storyscript_parse_source() returned
+    char *notes;          // messages written to the notes stream
+    size_t notes_len;
+    char *errors;         // messages written to stderr
+    size_t errors_len;
+    StoryImage image;
+} StoryCacheEntry;
+
+uint64_t story_cache_key(const char *text, size_t len, const char *filename,
+                         DiagLevel level, int max_errors);
+
+/* Reads the entry for `key`; returns 0 on a hit and -1 on a miss */
+int story_cache_lookup(const char *dir, uint64_t key, size_t text_len,
+                       StoryCacheEntry *entry);
+
+/*
+ * Stores the messages and status in `result` (its image is not used) with
+ * the image bytes `image` under `key`, creating `dir` if needed. Returns 0,
+ * or -1 (with a warning) if the entry cannot be written.
+ */
+int story_cache_store(const char *dir, uint64_t key, size_t text_len,
+                      const StoryCacheEntry *result, const StrBuf *image);
+
+void story_cache_entry_free(StoryCacheEntry *entry);
+
+#endif /* CACHE_H */
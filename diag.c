@@ -0,0 +1,71 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "diag.h"
+
+// Pending output is written out once a buffer grows past this
+#define DIAG_FLUSH_SIZE (64 * 1024)
+
+void diag_init(DiagSink *diag, DiagLevel level, FILE *out, FILE *err) {
+    diag->level = level;
+    diag->out = out;
+    diag->err = err;
+    strbuf_init(&diag->out_buf);
+    strbuf_init(&diag->err_buf);
+}
+
+void diag_free(DiagSink *diag) {
+    diag_flush(diag);
+    strbuf_free(&diag->out_buf);
+    strbuf_free(&diag->err_buf);
+}
+
+static void flush_buffer(StrBuf *buf, FILE *stream) {
+    if (buf->len == 0) return;
+    fwrite(buf->data, 1, buf->len, stream);
+    fflush(stream);
+    strbuf_reset(buf);
+}
+
+void diag_flush(DiagSink *diag) {
+    // Errors last, so they follow the progress that led up to them
+    if (diag->out) flush_buffer(&diag->out_buf, diag->out);
+    if (diag->err) flush_buffer(&diag->err_buf, diag->err);
+}
+
+void diag_printf(DiagSink *diag, DiagLevel level, const char *fmt, ...) {
+    FILE *stream = level == DIAG_ERROR ? diag->err : diag->out;
+    StrBuf *buf = level == DIAG_ERROR ? &diag->err_buf : &diag->out_buf;
+    if (!diag_enabled(diag, level) || !stream) return;
+
+    // Format straight into the buffer, growing it once if the guess was short
+    va_list args;
+    va_start(args, fmt);
+    strbuf_reserve(buf, 128);
+    int len = vsnprintf(buf->data + buf->len, buf->cap - buf->len, fmt, args);
+    va_end(args);
+    if (len < 0) return;
+
+    if ((size_t)len >= buf->cap - buf->len) {
+        strbuf_reserve(buf, (size_t)len + 1);
+        va_start(args, fmt);
+        vsnprintf(buf->data + buf->len, buf->cap - buf->len, fmt, args);
+        va_end(args);
+    }
+    buf->len += (size_t)len;
+
+    if (buf->len >= DIAG_FLUSH_SIZE) {
+        flush_buffer(buf, stream);
+    }
+}
+
+void diag_write(DiagSink *diag, DiagLevel level, const char *text, size_t len) {
+    FILE *stream = level == DIAG_ERROR ? diag->err : diag->out;
+    StrBuf *buf = level == DIAG_ERROR ? &diag->err_buf : &diag->out_buf;
+    if (!diag_enabled(diag, level) || !stream || len == 0) return;
+
+    strbuf_append(buf, text, len);
+    if (buf->len >= DIAG_FLUSH_SIZE) {
+        flush_buffer(buf, stream);
+    }
+}
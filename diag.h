@@ -0,0 +1,50 @@
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <stdio.h>
+#include "strbuf.h"
+
+/*
+ * Diagnostics sink of a parse. Messages are formatted into per-stream
+ * buffers and written out in bulk by diag_flush(), instead of one stdio
+ * call per message. Messages above the sink's level are dropped by the
+ * DIAG() macro before their arguments are even evaluated, so a quiet
+ * parse does no formatting work at all.
+ */
+
+typedef enum DiagLevel {
+    DIAG_ERROR,     // errors, always reported (-q)
+    DIAG_NOTE,      // one line summaries such as "Story parsed successfully"
+    DIAG_VERBOSE    // a line per room, choice, option and item (-v)
+} DiagLevel;
+
+typedef struct DiagSink {
+    DiagLevel level;   // most detailed level reported
+    FILE *out;         // notes and verbose messages, NULL to drop them
+    FILE *err;         // errors, NULL to drop them
+    StrBuf out_buf;    // pending output of each stream
+    StrBuf err_buf;
+} DiagSink;
+
+void diag_init(DiagSink *diag, DiagLevel level, FILE *out, FILE *err);
+
+/* Flushes whatever is pending, then releases the buffers */
+void diag_free(DiagSink *diag);
+
+void diag_flush(DiagSink *diag);
+
+void diag_printf(DiagSink *diag, DiagLevel level, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/* Appends `len` bytes of already formatted messages at `level` */
+void diag_write(DiagSink *diag, DiagLevel level, const char *text, size_t len);
+
+#define diag_enabled(diag, lvl) ((lvl) <= (diag)->level)
+
+#define DIAG(diag, lvl, ...)                          \
+    do {                                              \
+        if (diag_enabled(diag, lvl))                  \
+            diag_printf(diag, lvl, __VA_ARGS__);      \
+    } while (0)
+
+#endif /* DIAG_H */
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "export.h"
+
+static void put_str(StrBuf *out, const char *s) {
+    strbuf_append(out, s, strlen(s));
+}
+
+static void put_uint(StrBuf *out, uint32_t value) {
+    char digits[10];
+    size_t len = 0;
+    do {
+        digits[len++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    strbuf_reserve(out, len);
+    while (len) {
+        out->data[out->len++] = digits[--len];
+    }
+}
+
+// Writes `s` as a JSON string. Runs of plain bytes are copied in one go;
+// UTF-8 passes through untouched, since the format allows it.
+static void put_json_string(StrBuf *out, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+
+    if (!s) {
+        put_str(out, "null");
+        return;
+    }
+
+    strbuf_putc(out, '"');
+    const char *run = s;
+    for (;; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        strbuf_append(out, run, (size_t)(s - run));
+        if (c == '\0') break;
+        run = s + 1;
+
+        strbuf_putc(out, '\\');
+        switch (c) {
+            case '"':  strbuf_putc(out, '"'); break;
+            case '\\': strbuf_putc(out, '\\'); break;
+            case '\n': strbuf_putc(out, 'n'); break;
+            case '\r': strbuf_putc(out, 'r'); break;
+            case '\t': strbuf_putc(out, 't'); break;
+            case '\b': strbuf_putc(out, 'b'); break;
+            case '\f': strbuf_putc(out, 'f'); break;
+            default:
+                put_str(out, "u00");
+                strbuf_putc(out, hex[c >> 4]);
+                strbuf_putc(out, hex[c & 0xf]);
+                break;
+        }
+    }
+    strbuf_putc(out, '"');
+}
+
+static void write_text(const char *title, const StoryTables *t, StrBuf *out) {
+    put_str(out, "\n===== STORY =====\nTitle: ");
+    put_str(out, title ? title : "(untitled)");
+
+    // Items
+    put_str(out, "\n\n--- ITEMS ---\n");
+    if (t->item_count == 0) {
+        put_str(out, "No items defined\n");
+    }
+    for (uint32_t i = 0; i < t->item_count; i++) {
+        put_str(out, "* ");
+        put_str(out, story_string(t, t->item_name[i]));
+        put_str(out, ": ");
+        put_str(out, story_string(t, t->item_description[i]));
+        strbuf_putc(out, '\n');
+    }
+
+    // Rooms
+    put_str(out, "\n--- ROOMS ---\n");
+    if (t->room_count == 0) {
+        put_str(out, "No rooms defined\n");
+    }
+    for (uint32_t r = 0; r < t->room_count; r++) {
+        put_str(out, "\nROOM: ");
+        put_str(out, story_string(t, t->room_name[r]));
+        put_str(out, "\nDescription: ");
+        put_str(out, story_string(t, t->room_description[r]));
+        strbuf_putc(out, '\n');
+        if (t->room_ending[r]) put_str(out, "  Ending\n");
+
+        for (uint32_t c = t->room_first_choice[r]; c < t->room_first_choice[r + 1]; c++) {
+            put_str(out, "  Choice: ");
+            put_str(out, story_string(t, t->choice_text[c]));
+            strbuf_putc(out, '\n');
+
+            for (uint32_t o = t->choice_first_option[c]; o < t->choice_first_option[c + 1]; o++) {
+                put_str(out, "    Option: ");
+                put_str(out, story_string(t, t->option_text[o]));
+                put_str(out, " -> ");
+                put_str(out, story_string(t, t->option_target_name[o]));
+                strbuf_putc(out, '\n');
+            }
+        }
+    }
+
+    put_str(out, "\n================\n");
+}
+
+static void write_json(const char *title, const StoryTables *t, StrBuf *out) {
+    put_str(out, "{\"title\":");
+    put_json_string(out, title);
+
+    put_str(out, ",\"items\":[");
+    for (uint32_t i = 0; i < t->item_count; i++) {
+        put_str(out, i ? ",{\"name\":" : "{\"name\":");
+        put_json_string(out, story_string(t, t->item_name[i]));
+        put_str(out, ",\"description\":");
+        put_json_string(out, story_string(t, t->item_description[i]));
+        strbuf_putc(out, '}');
+    }
+
+    put_str(out, "],\"rooms\":[");
+    for (uint32_t r = 0; r < t->room_count; r++) {
+        put_str(out, r ? ",{\"name\":" : "{\"name\":");
+        put_json_string(out, story_string(t, t->room_name[r]));
+        put_str(out, ",\"description\":");
+        put_json_string(out, story_string(t, t->room_description[r]));
+        put_str(out, t->room_ending[r] ? ",\"ending\":true" : ",\"ending\":false");
+        put_str(out, ",\"choices\":[");
+
+        for (uint32_t c = t->room_first_choice[r]; c < t->room_first_choice[r + 1]; c++) {
+            put_str(out, c > t->room_first_choice[r] ? ",{\"text\":" : "{\"text\":");
+            put_json_string(out, story_string(t, t->choice_text[c]));
+            put_str(out, ",\"options\":[");
+
+            for (uint32_t o = t->choice_first_option[c]; o < t->choice_first_option[c + 1]; o++) {
+                put_str(out, o > t->choice_first_option[c] ? ",{\"text\":" : "{\"text\":");
+                put_json_string(out, story_string(t, t->option_text[o]));
+                put_str(out, ",\"target\":");
+                put_json_string(out, story_string(t, t->option_target_name[o]));
+
+                // Index into "rooms", or null for a dangling goto
+                put_str(out, ",\"target_index\":");
+                if (t->option_target[o] == STORY_NO_ROOM) {
+                    put_str(out, "null");
+                } else {
+                    put_uint(out, t->option_target[o]);
+                }
+                strbuf_putc(out, '}');
+            }
+            put_str(out, "]}");
+        }
+        put_str(out, "]}");
+    }
+    put_str(out, "]}\n");
+}
+
+void story_write_text(const Story *story, StrBuf *out) {
+    write_text(story->title, &story->tables, out);
+}
+
+void story_write_json(const Story *story, StrBuf *out) {
+    write_json(story->title, &story->tables, out);
+}
+
+int story_export(const Story *story, StoryFormat format, FILE *stream) {
+    return story_export_tables(story->title, &story->tables, format, stream);
+}
+
+int story_export_tables(const char *title, const StoryTables *tables,
+                        StoryFormat format, FILE *stream) {
+    StrBuf out;
+    strbuf_init(&out);
+
+    if (format == STORY_FORMAT_JSON) {
+        write_json(title, tables, &out);
+    } else {
+        write_text(title, tables, &out);
+    }
+
+    // Anything stdio still holds goes first
+    fflush(stream);
+    size_t written = fwrite(out.data, 1, out.len, stream);
+    int result = written == out.len && fflush(stream) == 0 ? 0 : -1;
+
+    strbuf_free(&out);
+    return result;
+}
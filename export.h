@@ -0,0 +1,30 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdio.h>
+#include "story.h"
+#include "strbuf.h"
+
+/*
+ * Story output. Each writer renders the whole story from its tables into
+ * one buffer, which story_export() hands to a single fwrite(), so output
+ * costs a memcpy per string instead of a stdio call per field.
+ */
+
+typedef enum StoryFormat {
+    STORY_FORMAT_TEXT,   // the human readable listing (story_write_text() in export.c)
+    STORY_FORMAT_JSON
+} StoryFormat;
+
+/* Append the story to `out` */
+void story_write_text(const Story *story, StrBuf *out);
+void story_write_json(const Story *story, StrBuf *out);
+
+/* Renders the story and writes it to `stream`; returns 0 on success */
+int story_export(const Story *story, StoryFormat format, FILE *stream);
+
+/* Same, for tables that do not come from a parsed story (a loaded image) */
+int story_export_tables(const char *title, const StoryTables *tables,
+                        StoryFormat format, FILE *stream);
+
+#endif /* EXPORT_H */
@@ -0,0 +1,320 @@
+/*
+ * Fuzz target for the parser.
+ *
+ * Every input is parsed from a buffer and streamed through the event
+ * parser, and a story that parses is exported, compiled to an image and
+ * loaded back, analyzed, and has one room parsed again from its own text.
+ * Beyond what the sanitizers catch, the target aborts when the results
+ * disagree: a clean parse must give a clean event parse, an image the
+ * loader accepts, and the same listing after the room is re-parsed.
+ *
+ * Built with clang -fsanitize=fuzzer this is a libFuzzer target (make
+ * fuzz). Built with -DSTORYSCRIPT_FUZZ_DRIVER it is a program that runs
+ * the files and directories named on its command line through the same
+ * checks (make fuzz-scaling, or an AFL build with CC=afl-clang-fast run on
+ * @@). The driver also times a parse of each input and of the input with
+ * its story body repeated, and flags inputs whose time per byte grows
+ * with their size: quadratic scans show up there long before they show up
+ * as timeouts.
+ *
+ * Includes are resolved against the working directory, so run it from
+ * a directory without stories in it.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "analyze.h"
+#include "export.h"
+#include "image.h"
+#include "story.h"
+
+// Messages are formatted, as they would be, then thrown away
+static FILE *null_stream(void) {
+    static FILE *stream;
+    if (!stream) stream = fopen("/dev/null", "w");
+    if (!stream) {
+        fprintf(stderr, "Error: Cannot open /dev/null\n");
+        exit(1);
+    }
+    return stream;
+}
+
+static void init_ctx(StoryParseCtx *ctx, DiagLevel level) {
+    story_parse_ctx_init(ctx, "fuzz.story");
+    diag_free(&ctx->diag);
+    diag_init(&ctx->diag, level, null_stream(), null_stream());
+    ctx->max_errors = 0;   // hostile input makes the most errors, so read it all
+    ctx->jobs = 1;
+}
+
+static void check(int ok, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "Error: %s\n", what);
+        abort();
+    }
+}
+
+// The listing, which covers every node the parser keeps
+static void listing(const Story *story, StrBuf *out) {
+    strbuf_reset(out);
+    story_write_text(story, out);
+}
+
+static void check_image(const Story *story) {
+    StrBuf built;
+    strbuf_init(&built);
+    if (story_image_build(story, &built) == 0) {
+        char *data = (char *)malloc(built.len);
+        check(data != NULL, "Memory allocation failed");
+        memcpy(data, built.data, built.len);
+
+        StoryImage image;
+        check(story_image_from_buffer(&image, data, built.len) == 0, "image rejected by its loader");
+        const StoryTables *tables = &image.tables;
+        for (uint32_t i = 0; i < tables->item_count; i++) {
+            const char *name = story_string(tables, tables->item_name[i]);
+            check(story_find_item(tables, name) == i, "item not found by name");
+        }
+        story_export_tables(story->title, tables, STORY_FORMAT_JSON, null_stream());
+        story_image_close(&image);
+    }
+    strbuf_free(&built);
+}
+
+// `data` is the input: the story's own copy has its string literals
+// terminated in place
+static void check_reparse(StoryParseCtx *ctx, const char *data, int clean) {
+    Story *story = ctx->story;
+    Room *room = story->rooms;
+    while (room && (room->file || room->source_end <= room->source_start)) room = room->next;
+    if (!room) return;
+
+    StrBuf before, after;
+    strbuf_init(&before);
+    strbuf_init(&after);
+    listing(story, &before);
+
+    const char *text = data + room->source_start;
+    int result = storyscript_reparse_room(ctx, room, text, room->source_end - room->source_start);
+    if (clean) {
+        check(result == 0, "room of a clean story does not parse again");
+        listing(story, &after);
+        check(before.len == after.len && memcmp(before.data, after.data, before.len) == 0,
+              "re-parsing a room with its own text changed the story");
+    }
+    strbuf_free(&before);
+    strbuf_free(&after);
+}
+
+static void fuzz_one(const char *data, size_t size) {
+    StoryParseCtx ctx;
+    init_ctx(&ctx, DIAG_VERBOSE);
+    int clean = storyscript_parse(data, size, &ctx) == 0;
+
+    if (ctx.story) {
+        story_export(ctx.story, STORY_FORMAT_TEXT, null_stream());
+        story_export(ctx.story, STORY_FORMAT_JSON, null_stream());
+        check_image(ctx.story);
+
+        StoryAnalysis analysis;
+        story_analyze(&ctx.story->tables, &analysis);
+        story_analysis_print(&ctx.story->tables, &analysis, null_stream());
+        story_analysis_free(&analysis);
+
+        check_reparse(&ctx, data, clean);
+    }
+    free_story(ctx.story);
+    story_parse_ctx_free(&ctx);
+
+    // The stream parser reads the same text through flex's own buffer
+    FILE *in = fmemopen((void *)data, size ? size : 1, "r");
+    check(in != NULL, "Cannot open the input as a stream");
+    if (size == 0) fgetc(in);
+    StoryEvents events;
+    memset(&events, 0, sizeof(events));
+    init_ctx(&ctx, DIAG_VERBOSE);
+    int events_clean = storyscript_parse_events(in, &events, &ctx) == 0;
+    check(!clean || events_clean, "event parse fails on a story that parses");
+    story_parse_ctx_free(&ctx);
+    fclose(in);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    fuzz_one((const char *)data, size);
+    return 0;
+}
+
+#ifdef STORYSCRIPT_FUZZ_DRIVER
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Best time of one quiet parse, repeated until the clock can be trusted
+static double time_parse(const char *text, size_t len) {
+    double best = 1e30;
+    for (int round = 0; round < 3; round++) {
+        int runs = 0;
+        double start = now(), elapsed;
+        do {
+            StoryParseCtx ctx;
+            story_parse_ctx_init(&ctx, "fuzz.story");
+            diag_free(&ctx.diag);
+            diag_init(&ctx.diag, DIAG_ERROR, NULL, NULL);
+            ctx.max_errors = 0;
+            ctx.jobs = 1;
+            storyscript_parse(text, len, &ctx);
+            free_story(ctx.story);
+            story_parse_ctx_free(&ctx);
+            runs++;
+            elapsed = now() - start;
+        } while (elapsed < 0.002);
+        if (elapsed / runs < best) best = elapsed / runs;
+    }
+    return best;
+}
+
+// Both sizes of the scaling check are at least this large, so that a cost
+// per room that grows with the rooms before it outweighs the fixed costs
+#define SCALE_BASE_BYTES (64 * 1024)
+
+// The part of the input that is repeated: what is between its first "{"
+// and its last "}", so a story grows rooms rather than trailing garbage
+static void body_span(const char *data, size_t size, size_t *head, size_t *body) {
+    const char *open = memchr(data, '{', size);
+    const char *close = NULL;
+    for (size_t i = size; open && i > (size_t)(open - data) + 1; i--) {
+        if (data[i - 1] == '}') {
+            close = data + i - 1;
+            break;
+        }
+    }
+    *head = close ? (size_t)(open + 1 - data) : 0;
+    *body = close ? (size_t)(close - open - 1) : size;
+}
+
+// The input with its body written `factor` times
+static char *scale_input(const char *data, size_t size, size_t factor, size_t *len) {
+    size_t head, body;
+    body_span(data, size, &head, &body);
+    size_t tail = size - head - body;
+
+    *len = head + body * factor + tail;
+    char *scaled = (char *)malloc(*len ? *len : 1);
+    if (!scaled) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(scaled, data, head);
+    for (size_t i = 0; i < factor; i++) {
+        memcpy(scaled + head + body * i, data + head, body);
+    }
+    memcpy(scaled + head + body * factor, data + head + body, tail);
+    return scaled;
+}
+
+typedef struct DriverOptions {
+    int factor;       // growth of the body between the two sizes timed
+    double limit;     // flag inputs whose time per byte grows more than this
+    int flagged;
+} DriverOptions;
+
+static void run_file(const char *path, DriverOptions *options) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", path);
+        exit(1);
+    }
+    SourceBuffer source;
+    source_init(&source);
+    source_read_stream(&source, file);
+    fclose(file);
+
+    fuzz_one(source.data, source.len);
+
+    size_t head, body;
+    body_span(source.data, source.len, &head, &body);
+    if (options->factor > 1 && body > 0) {
+        size_t repeat = (SCALE_BASE_BYTES + body - 1) / body;
+        size_t small_len, large_len;
+        char *small = scale_input(source.data, source.len, repeat, &small_len);
+        char *large = scale_input(source.data, source.len, repeat * options->factor, &large_len);
+        double own = time_parse(source.data, source.len) / (double)source.len;
+        double base = time_parse(small, small_len) / (double)small_len;
+        double grown = time_parse(large, large_len) / (double)large_len;
+        free(small);
+        free(large);
+
+        int superlinear = grown > base * options->limit;
+        printf("%-40s %8zu bytes %8.2f ns/byte, %9zu: %8.2f, %9zu: %8.2f%s\n", path,
+               source.len, own * 1e9, small_len, base * 1e9, large_len, grown * 1e9,
+               superlinear ? "  SUPERLINEAR" : "");
+        options->flagged += superlinear;
+    }
+    source_release(&source);
+}
+
+static void run_path(const char *path, DriverOptions *options) {
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        DIR *dir = opendir(path);
+        if (!dir) {
+            fprintf(stderr, "Error: Cannot open directory '%s'\n", path);
+            exit(1);
+        }
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.') continue;
+            char *child;
+            if (asprintf(&child, "%s/%s", path, entry->d_name) < 0) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            run_file(child, options);
+            free(child);
+        }
+        closedir(dir);
+    } else {
+        run_file(path, options);
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-s factor] [-l limit] file-or-directory...\n", prog);
+}
+
+int main(int argc, char **argv) {
+    DriverOptions options = { 8, 2.0, 0 };
+    int inputs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            options.factor = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            options.limit = atof(argv[++i]);
+        } else {
+            argv[++inputs] = argv[i];
+        }
+    }
+    if (inputs == 0 || options.factor < 1 || options.limit <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int i = 1; i <= inputs; i++) {
+        run_path(argv[i], &options);
+    }
+    if (options.flagged) {
+        printf("%d input%s with super-linear parse time\n", options.flagged,
+               options.flagged == 1 ? "" : "s");
+    }
+    return options.flagged != 0;
+}
+#endif /* STORYSCRIPT_FUZZ_DRIVER */
@@ -0,0 +1,99 @@
+/*
+ * Synthetic story generator for the benchmarks.
+ *
+ * Writes a well-formed story with N rooms of M choices of K options each
+ * to stdout. Every goto names an existing room, descriptions are about L
+ * bytes of filler words, and every eighth one carries an escaped quote so
+ * both string literal paths of the lexer are exercised. The same arguments
+ * always produce the same file.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+static const char *words[] = {
+    "the", "forest", "path", "winds", "past", "an", "old", "stone", "wall",
+    "moss", "covers", "every", "surface", "and", "a", "cold", "wind", "blows",
+    "through", "branches", "overhead", "lantern", "light", "flickers", "dark"
+};
+
+static uint64_t rng_state;
+
+// xorshift64*: small, fast and identical on every platform
+static uint64_t next_random(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static void write_text(FILE *out, long len, int escaped) {
+    long written = 0;
+    while (written < len) {
+        const char *word = words[next_random() % (sizeof(words) / sizeof(words[0]))];
+        written += fprintf(out, written ? " %s" : "%s", word);
+    }
+    if (escaped) fputs(" \\\"quoted\\\"", out);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-r rooms] [-c choices] [-o options] [-d description_length] [-s seed]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    long rooms = 1000;
+    long choices = 2;
+    long options = 3;
+    long desc_len = 120;
+    uint64_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:c:o:d:s:")) != -1) {
+        switch (opt) {
+            case 'r': rooms = atol(optarg); break;
+            case 'c': choices = atol(optarg); break;
+            case 'o': options = atol(optarg); break;
+            case 'd': desc_len = atol(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (rooms < 1 || choices < 0 || options < 0 || desc_len < 0 || optind != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    rng_state = seed ? seed : 1;
+
+    FILE *out = stdout;
+    fprintf(out, "story {\n    title: \"Generated story: %ld rooms\";\n\n", rooms);
+
+    fprintf(out, "    inventory {\n");
+    for (long i = 0; i < 4; i++) {
+        fprintf(out, "        item item%ld {\n            description: \"", i);
+        write_text(out, desc_len / 2, 0);
+        fprintf(out, "\";\n        }\n");
+    }
+    fprintf(out, "    }\n");
+
+    for (long r = 0; r < rooms; r++) {
+        fprintf(out, "\n    // Room %ld\n    room room%ld {\n        description: \"", r, r);
+        write_text(out, desc_len, r % 8 == 7);
+        fprintf(out, "\";\n");
+
+        for (long c = 0; c < choices; c++) {
+            fprintf(out, "\n        choice \"Choice %ld of room %ld\" {\n", c, r);
+            for (long o = 0; o < options; o++) {
+                fprintf(out, "            option \"Option %ld\" goto room%ld;\n",
+                        o, (long)(next_random() % (uint64_t)rooms));
+            }
+            fprintf(out, "        }\n");
+        }
+        fprintf(out, "    }\n");
+    }
+
+    fprintf(out, "}\n");
+    return ferror(out) ? 1 : 0;
+}
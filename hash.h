@@ -0,0 +1,10 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* XXH64 of `len` bytes; about memory bandwidth, for content addressing */
+uint64_t hash_xxh64(const void *data, size_t len, uint64_t seed);
+
+#endif /* HASH_H */
@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "arena.h"
+#include "host.h"
+#include "image.h"
+#include "intern.h"
+#include "symtab.h"
+
+#define HOST_IDLE UINT64_MAX   // generation announced by a reader slot nobody holds
+
+/* How the sessions of one older version move onto a newer one */
+typedef struct StoryMigration {
+    uint64_t from;            // generation the sessions come from
+    uint32_t room_count;      // rooms and items of that version
+    uint32_t item_count;
+    uint32_t *room_map;       // its room index -> room here, or STORY_NO_ROOM
+    uint32_t *item_map;       // its item ID -> item here, or STORY_NO_ITEM
+    struct StoryMigration *next;
+} StoryMigration;
+
+typedef struct StoryVersion {
+    uint64_t generation;
+    StoryImage image;
+    StoryRuntime runtime;
+    StoryMigration *migrations;
+    struct StoryVersion *next;   // retired versions, newest first
+} StoryVersion;
+
+// One cache line each, so readers announcing their epochs don't share lines
+struct StoryReader {
+    _Alignas(64) _Atomic uint64_t generation;
+    StoryVersion *version;    // only touched by the reader's thread
+    StoryHost *host;
+};
+
+struct StoryHost {
+    _Atomic(StoryVersion *) current;
+    _Atomic uint64_t generation;
+    pthread_mutex_t lock;     // serializes loads, joins and collection
+    StoryVersion *retired;
+    StoryReader *readers;
+    size_t max_readers;
+};
+
+static void *host_alloc(size_t count, size_t size) {
+    void *p = malloc(count ? count * size : 1);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return p;
+}
+
+StoryHost *story_host_create(size_t max_readers) {
+    StoryHost *host = (StoryHost *)host_alloc(1, sizeof(StoryHost));
+    size_t bytes = (max_readers ? max_readers : 1) * sizeof(StoryReader);
+    host->readers = (StoryReader *)aligned_alloc(_Alignof(StoryReader), bytes);
+    if (!host->readers) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < max_readers; i++) {
+        atomic_init(&host->readers[i].generation, HOST_IDLE);
+        host->readers[i].version = NULL;
+        host->readers[i].host = host;
+    }
+    host->max_readers = max_readers;
+    atomic_init(&host->current, NULL);
+    atomic_init(&host->generation, 0);
+    host->retired = NULL;
+    pthread_mutex_init(&host->lock, NULL);
+    return host;
+}
+
+static void version_free(StoryVersion *version) {
+    StoryMigration *migration = version->migrations;
+    while (migration) {
+        StoryMigration *next = migration->next;
+        free(migration->room_map);
+        free(migration->item_map);
+        free(migration);
+        migration = next;
+    }
+    story_image_close(&version->image);
+    free(version);
+}
+
+void story_host_destroy(StoryHost *host) {
+    StoryVersion *current = atomic_load(&host->current);
+    if (current) version_free(current);
+    while (host->retired) {
+        StoryVersion *next = host->retired->next;
+        version_free(host->retired);
+        host->retired = next;
+    }
+    pthread_mutex_destroy(&host->lock);
+    free(host->readers);
+    free(host);
+}
+
+// A reader plays its own generation and loads nothing older than that, so
+// every retired version older than all announced generations is unreachable
+static size_t collect_locked(StoryHost *host) {
+    uint64_t oldest = HOST_IDLE;
+    for (size_t i = 0; i < host->max_readers; i++) {
+        uint64_t generation = atomic_load_explicit(&host->readers[i].generation,
+                                                   memory_order_acquire);
+        if (generation < oldest) oldest = generation;
+    }
+
+    size_t freed = 0;
+    StoryVersion **link = &host->retired;
+    while (*link) {
+        StoryVersion *version = *link;
+        if (version->generation < oldest) {
+            *link = version->next;
+            version_free(version);
+            freed++;
+        } else {
+            link = &version->next;
+        }
+    }
+    return freed;
+}
+
+size_t story_host_collect(StoryHost *host) {
+    pthread_mutex_lock(&host->lock);
+    size_t freed = collect_locked(host);
+    pthread_mutex_unlock(&host->lock);
+    return freed;
+}
+
+// Maps `from` onto `to`. `rooms` holds the rooms of `to` by their names
+// interned in `names`, stored as index + 1 so that no room is NULL.
+static void add_migration(StoryVersion *to, const StoryVersion *from,
+                          InternPool *names, const SymTab *rooms) {
+    const StoryTables *old = &from->image.tables;
+    StoryMigration *migration = (StoryMigration *)host_alloc(1, sizeof(StoryMigration));
+    migration->from = from->generation;
+    migration->room_count = old->room_count;
+    migration->item_count = old->item_count;
+    migration->room_map = (uint32_t *)host_alloc(old->room_count, sizeof(uint32_t));
+    migration->item_map = (uint32_t *)host_alloc(old->item_count, sizeof(uint32_t));
+
+    for (uint32_t r = 0; r < old->room_count; r++) {
+        const char *name = intern_cstring(names, story_string(old, old->room_name[r]));
+        void *room = symtab_get(rooms, NULL, name);
+        migration->room_map[r] = room ? (uint32_t)((uintptr_t)room - 1) : STORY_NO_ROOM;
+    }
+    for (uint32_t i = 0; i < old->item_count; i++) {
+        const char *name = story_string(old, old->item_name[i]);
+        migration->item_map[i] = story_find_item(&to->image.tables, name);
+    }
+
+    migration->next = to->migrations;
+    to->migrations = migration;
+}
+
+int story_host_load(StoryHost *host, const char *path) {
+    StoryVersion *version = (StoryVersion *)host_alloc(1, sizeof(StoryVersion));
+    int result = story_image_load(&version->image, path);
+    if (result != 0) {
+        free(version);
+        return result;
+    }
+    // Sessions carry their items between versions, so they must fit
+    if (story_runtime_init(&version->runtime, &version->image.tables) != 0) {
+        story_image_close(&version->image);
+        free(version);
+        return -3;
+    }
+    version->migrations = NULL;
+    version->next = NULL;
+
+    Arena arena;
+    InternPool names;
+    SymTab rooms;
+    arena_init(&arena);
+    intern_init(&names, &arena);
+    symtab_init(&rooms);
+    const StoryTables *tables = &version->image.tables;
+    for (uint32_t r = 0; r < tables->room_count; r++) {
+        const char *name = intern_cstring(&names, story_string(tables, tables->room_name[r]));
+        symtab_put(&rooms, NULL, name, (void *)(uintptr_t)(r + 1));
+    }
+
+    // Readers may still play any version that survives collection, so the
+    // new one carries a map from each of them
+    pthread_mutex_lock(&host->lock);
+    collect_locked(host);
+    StoryVersion *current = atomic_load_explicit(&host->current, memory_order_relaxed);
+    version->generation = atomic_load_explicit(&host->generation, memory_order_relaxed) + 1;
+    if (current) add_migration(version, current, &names, &rooms);
+    for (StoryVersion *old = host->retired; old; old = old->next) {
+        add_migration(version, old, &names, &rooms);
+    }
+
+    atomic_store_explicit(&host->current, version, memory_order_release);
+    atomic_store_explicit(&host->generation, version->generation, memory_order_relaxed);
+    if (current) {
+        current->next = host->retired;
+        host->retired = current;
+    }
+    pthread_mutex_unlock(&host->lock);
+
+    symtab_free(&rooms);
+    intern_free(&names);
+    arena_free(&arena);
+    return 0;
+}
+
+uint64_t story_host_generation(const StoryHost *host) {
+    return atomic_load_explicit(&host->generation, memory_order_relaxed);
+}
+
+StoryReader *story_host_join(StoryHost *host) {
+    StoryReader *reader = NULL;
+    pthread_mutex_lock(&host->lock);
+    StoryVersion *current = atomic_load_explicit(&host->current, memory_order_relaxed);
+    for (size_t i = 0; current && i < host->max_readers; i++) {
+        if (atomic_load_explicit(&host->readers[i].generation, memory_order_relaxed) == HOST_IDLE) {
+            reader = &host->readers[i];
+            reader->version = current;
+            atomic_store_explicit(&reader->generation, current->generation, memory_order_release);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&host->lock);
+    return reader;
+}
+
+void story_reader_leave(StoryReader *reader) {
+    reader->version = NULL;
+    atomic_store_explicit(&reader->generation, HOST_IDLE, memory_order_release);
+}
+
+static void migrate_session(const StoryMigration *migration, StorySession *session) {
+    if (session->room != STORY_NO_ROOM) {
+        session->room = session->room < migration->room_count ? migration->room_map[session->room]
+                                                              : STORY_NO_ROOM;
+    }
+
+    uint64_t inventory = session->inventory, moved = 0;
+    while (inventory) {
+        uint32_t item = (uint32_t)__builtin_ctzll(inventory);
+        inventory &= inventory - 1;
+        uint32_t to = item < migration->item_count ? migration->item_map[item] : STORY_NO_ITEM;
+        if (to < STORY_SESSION_MAX_ITEMS) moved |= (uint64_t)1 << to;
+    }
+    session->inventory = moved;
+}
+
+int story_reader_update(StoryReader *reader, StorySession *sessions, size_t n) {
+    StoryVersion *current = atomic_load_explicit(&reader->host->current, memory_order_acquire);
+    if (current == reader->version) return 0;
+
+    // Until the store below the reader's generation keeps its own version
+    // and everything newer, `current` included, from being freed. The
+    // loader mapped every version that was still in use, so ours should be
+    // there; if it is not, the sessions start over rather than guess.
+    const StoryMigration *migration = current->migrations;
+    while (migration && migration->from != reader->version->generation) {
+        migration = migration->next;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (migration) {
+            migrate_session(migration, &sessions[i]);
+        } else {
+            story_session_start(&current->runtime, &sessions[i]);
+        }
+    }
+
+    reader->version = current;
+    atomic_store_explicit(&reader->generation, current->generation, memory_order_release);
+    return 1;
+}
+
+const StoryRuntime *story_reader_runtime(const StoryReader *reader) {
+    return &reader->version->runtime;
+}
+
+const StoryTables *story_reader_tables(const StoryReader *reader) {
+    return &reader->version->image.tables;
+}
+
+uint64_t story_reader_generation(const StoryReader *reader) {
+    return reader->version->generation;
+}
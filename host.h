@@ -0,0 +1,87 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "runtime.h"
+
+/*
+ * Hot reload of compiled stories in a running server.
+ *
+ * A StoryHost owns the published version of a story: a loaded .storyc
+ * image with its tables and runtime. story_host_load() maps a new image,
+ * which a loader thread can do while play goes on, and publishes it with
+ * one atomic pointer store. Along with it goes a room map from every
+ * version still in use, built by name through a symbol table, and an item
+ * map built through the item index.
+ *
+ * Each worker thread joins as a StoryReader and plays its own sessions
+ * against its reader's version. Once per tick it calls
+ * story_reader_update(): one atomic load while nothing changed, and when a
+ * new version is out, a pass that moves its sessions to the same rooms and
+ * items by name. Readers never take a lock or wait for the loader.
+ *
+ * Old versions are reclaimed by epoch: every reader announces the
+ * generation it plays, and story_host_collect() frees the retired versions
+ * older than all of them. Nothing a reader can still reach is older than
+ * its own generation, so a version is only freed once every session has
+ * left it.
+ *
+ * This is an internal interface, not part of libstoryscript: the library
+ * exports storyscript.h alone and hides these functions along with the
+ * StoryTables they hand out. A server that hot reloads builds host.c and
+ * the rest of the Makefile's SOURCES into itself. make reload-stress runs
+ * it under ThreadSanitizer and ASan (see reload.c).
+ */
+
+typedef struct StoryHost StoryHost;
+typedef struct StoryReader StoryReader;
+
+/* A host for up to `max_readers` readers at once, with no story yet */
+StoryHost *story_host_create(size_t max_readers);
+
+/* Frees the host and every version; all readers must have left */
+void story_host_destroy(StoryHost *host);
+
+/*
+ * Loads the image at `path` and publishes it as the next version. Loads
+ * from several threads are serialized. Returns 0, the error of
+ * story_image_load(), or -3 if the story has more than
+ * STORY_SESSION_MAX_ITEMS items; on an error the current version stays
+ * as it was.
+ */
+int story_host_load(StoryHost *host, const char *path);
+
+/* Frees the retired versions no reader plays any more; returns how many */
+size_t story_host_collect(StoryHost *host);
+
+/* Generation of the published version: 1 for the first load, 0 before it */
+uint64_t story_host_generation(const StoryHost *host);
+
+/*
+ * Joins a reader on the published version. Returns NULL if nothing has
+ * been loaded yet or `max_readers` readers have joined. A reader belongs
+ * to one thread at a time.
+ */
+StoryReader *story_host_join(StoryHost *host);
+
+/* Leaves the host; the reader's version can then be reclaimed */
+void story_reader_leave(StoryReader *reader);
+
+/*
+ * Moves the reader and its `n` sessions to the published version if there
+ * is a newer one, and returns 1, or 0 if it was already current. The
+ * sessions must be all of those played against the reader's version.
+ * A session keeps its steps and moves to the room of the same name; if
+ * there is none it ends up in STORY_NO_ROOM, which counts as finished.
+ * Items that are gone are dropped from inventories. Sessions of a
+ * version the new one has no map from start over in its first room.
+ */
+int story_reader_update(StoryReader *reader, StorySession *sessions, size_t n);
+
+/* The reader's version, valid until its next update */
+const StoryRuntime *story_reader_runtime(const StoryReader *reader);
+const StoryTables *story_reader_tables(const StoryReader *reader);
+uint64_t story_reader_generation(const StoryReader *reader);
+
+#endif /* HOST_H */
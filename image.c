@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "image.h"
+
+#define IMAGE_ALIGN 8
+
+static void *image_calloc(size_t count, size_t size) {
+    void *ptr = calloc(count ? count : 1, size);
+    if (!ptr) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+static uint64_t add_string(StrBuf *strings, const char *s) {
+    if (!s) return STORY_NO_STRING;
+    uint64_t offset = strings->len;
+    strbuf_append(strings, s, strlen(s) + 1);
+    return offset;
+}
+
+// Appends a table to the image, starting on an aligned offset
+static uint64_t add_table(StrBuf *out, const void *table, size_t size) {
+    static const char padding[IMAGE_ALIGN];
+    size_t pad = (IMAGE_ALIGN - out->len % IMAGE_ALIGN) % IMAGE_ALIGN;
+    strbuf_append(out, padding, pad);
+    uint64_t offset = out->len;
+    if (size) strbuf_append(out, (const char *)table, size);
+    return offset;
+}
+
+// Appends the strings behind `count` refs to the blob, and the table of
+// their offsets there to the image
+static uint64_t add_strings(StrBuf *out, StrBuf *strings, const StoryTables *t,
+                            const StoryStringRef *refs, uint32_t count) {
+    StoryStringRef *offsets = image_calloc(count, sizeof(StoryStringRef));
+    for (uint32_t i = 0; i < count; i++) {
+        offsets[i] = add_string(strings, story_string(t, refs[i]));
+    }
+    uint64_t offset = add_table(out, offsets, count * sizeof(StoryStringRef));
+    free(offsets);
+    return offset;
+}
+
+int story_image_build(const Story *story, StrBuf *out) {
+    const StoryTables *t = &story->tables;
+    uint32_t rooms = t->room_count;
+    uint32_t choices = t->choice_count;
+    uint32_t options = t->option_count;
+    uint32_t items = t->item_count;
+
+    StrBuf strings;
+    strbuf_init(&strings);
+
+    StoryImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STORY_IMAGE_MAGIC, 4);
+    header.version = STORY_IMAGE_VERSION;
+    header.byte_order = STORY_IMAGE_BYTE_ORDER;
+    header.title = add_string(&strings, story->title);
+    header.room_count = rooms;
+    header.choice_count = choices;
+    header.option_count = options;
+    header.item_count = items;
+    header.item_slot_count = t->item_slot_count;
+
+    // The tables are already in image order; only strings become offsets
+    strbuf_reset(out);
+    strbuf_append(out, (const char *)&header, sizeof(header));
+    header.room_name = add_strings(out, &strings, t, t->room_name, rooms);
+    header.room_description = add_strings(out, &strings, t, t->room_description, rooms);
+    header.room_first_choice = add_table(out, t->room_first_choice, (rooms + 1) * sizeof(uint32_t));
+    header.room_first_option = add_table(out, t->room_first_option, (rooms + 1) * sizeof(uint32_t));
+    header.room_ending = add_table(out, t->room_ending, rooms * sizeof(uint8_t));
+    header.choice_text = add_strings(out, &strings, t, t->choice_text, choices);
+    header.choice_first_option = add_table(out, t->choice_first_option,
+                                           (choices + 1) * sizeof(uint32_t));
+    header.option_text = add_strings(out, &strings, t, t->option_text, options);
+    header.option_target_name = add_strings(out, &strings, t, t->option_target_name, options);
+    header.option_target = add_table(out, t->option_target, options * sizeof(uint32_t));
+    header.item_name = add_strings(out, &strings, t, t->item_name, items);
+    header.item_description = add_strings(out, &strings, t, t->item_description, items);
+    header.item_slots = add_table(out, t->item_slots, t->item_slot_count * sizeof(uint32_t));
+    header.strings_offset = add_table(out, strings.data, strings.len);
+    header.strings_size = strings.len;
+    memcpy(out->data, &header, sizeof(header));
+
+    strbuf_free(&strings);
+    return 0;
+}
+
+// The table of `count` entries of `size` bytes at `offset`, if it lies
+// aligned inside the image, or NULL
+static void *image_table(const StoryImage *image, uint64_t offset,
+                         uint64_t count, size_t size) {
+    if (offset % IMAGE_ALIGN != 0 || offset > image->size ||
+        count * size > image->size - offset) {
+        return NULL;
+    }
+    return (char *)image->data + offset;
+}
+
+static int strings_ok(const StoryImage *image, const StoryStringRef *refs, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (refs[i] >= image->header->strings_size) return 0;
+    }
+    return 1;
+}
+
+// Range starts begin at 0, never go down and end at `total`
+static int ranges_ok(const uint32_t *first, uint32_t count, uint32_t total) {
+    if (first[0] != 0 || first[count] != total) return 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (first[i] > first[i + 1]) return 0;
+    }
+    return 1;
+}
+
+// Checks everything the readers index with, so they never need to, and
+// points the tables into the image
+static int image_check(StoryImage *image) {
+    if (image->size < sizeof(StoryImageHeader)) return -2;
+
+    const StoryImageHeader *header = (const StoryImageHeader *)image->data;
+    if (memcmp(header->magic, STORY_IMAGE_MAGIC, 4) != 0 ||
+        header->version != STORY_IMAGE_VERSION ||
+        header->byte_order != STORY_IMAGE_BYTE_ORDER) {
+        return -2;
+    }
+    image->header = header;
+
+    // The mapping is read-only; the tables are only ever read
+    uint32_t rooms = header->room_count;
+    uint32_t choices = header->choice_count;
+    uint32_t options = header->option_count;
+    uint32_t items = header->item_count;
+    size_t ref = sizeof(StoryStringRef);
+    StoryTables *t = &image->tables;
+    t->room_count = rooms;
+    t->choice_count = choices;
+    t->option_count = options;
+    t->item_count = items;
+    t->room_name = image_table(image, header->room_name, rooms, ref);
+    t->room_description = image_table(image, header->room_description, rooms, ref);
+    t->room_first_choice = image_table(image, header->room_first_choice, rooms + 1ull, 4);
+    t->room_first_option = image_table(image, header->room_first_option, rooms + 1ull, 4);
+    t->room_ending = image_table(image, header->room_ending, rooms, 1);
+    t->choice_text = image_table(image, header->choice_text, choices, ref);
+    t->choice_first_option = image_table(image, header->choice_first_option, choices + 1ull, 4);
+    t->option_text = image_table(image, header->option_text, options, ref);
+    t->option_target_name = image_table(image, header->option_target_name, options, ref);
+    t->option_target = image_table(image, header->option_target, options, 4);
+    t->item_name = image_table(image, header->item_name, items, ref);
+    t->item_description = image_table(image, header->item_description, items, ref);
+    t->item_slot_count = header->item_slot_count;
+    t->item_slots = image_table(image, header->item_slots, t->item_slot_count, 4);
+    image->strings = image_table(image, header->strings_offset, header->strings_size, 1);
+    if (!t->room_name || !t->room_description || !t->room_first_choice ||
+        !t->room_first_option || !t->room_ending || !t->choice_text ||
+        !t->choice_first_option || !t->option_text || !t->option_target_name ||
+        !t->option_target || !t->item_name || !t->item_description || !t->item_slots ||
+        !image->strings) {
+        return -2;
+    }
+    t->string_base = (uintptr_t)image->strings;
+
+    // Every string must end inside the blob
+    if (header->strings_size && image->strings[header->strings_size - 1] != '\0') {
+        return -2;
+    }
+    if (header->title != STORY_NO_STRING && header->title >= header->strings_size) {
+        return -2;
+    }
+    if (!strings_ok(image, t->room_name, rooms) ||
+        !strings_ok(image, t->room_description, rooms) ||
+        !strings_ok(image, t->choice_text, choices) ||
+        !strings_ok(image, t->option_text, options) ||
+        !strings_ok(image, t->option_target_name, options) ||
+        !strings_ok(image, t->item_name, items) ||
+        !strings_ok(image, t->item_description, items)) {
+        return -2;
+    }
+
+    // Ranges follow each other without gaps, the way the writer lays them out
+    if (!ranges_ok(t->room_first_choice, rooms, choices) ||
+        !ranges_ok(t->choice_first_option, choices, options)) {
+        return -2;
+    }
+    for (uint32_t r = 0; r <= rooms; r++) {
+        if (t->room_first_option[r] != t->choice_first_option[t->room_first_choice[r]]) {
+            return -2;
+        }
+    }
+    for (uint32_t r = 0; r < rooms; r++) {
+        if (t->room_ending[r] > 1) return -2;
+    }
+    for (uint32_t o = 0; o < options; o++) {
+        if (t->option_target[o] != STORY_NO_ROOM && t->option_target[o] >= rooms) return -2;
+    }
+
+    // Lookups stop at an empty slot, so there must be one, and index the
+    // item table with what they find
+    uint32_t slots = t->item_slot_count;
+    if (slots & (slots - 1) || (items && slots <= items)) {
+        return -2;
+    }
+    uint32_t used = 0;
+    for (uint32_t s = 0; s < slots; s++) {
+        uint32_t item = t->item_slots[s];
+        if (item == STORY_NO_ITEM) continue;
+        if (item >= items) return -2;
+        used++;
+    }
+    if (used != items) return -2;
+    return 0;
+}
+
+int story_image_load(StoryImage *image, const char *path) {
+    memset(image, 0, sizeof(*image));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return -2;
+    }
+
+    // Read-only and shared: every process using this image shares its pages
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+
+    image->data = data;
+    image->size = (size_t)st.st_size;
+    image->mapped = 1;
+
+    int result = image_check(image);
+    if (result != 0) {
+        story_image_close(image);
+    }
+    return result;
+}
+
+int story_image_from_buffer(StoryImage *image, void *data, size_t size) {
+    memset(image, 0, sizeof(*image));
+    image->data = data;
+    image->size = size;
+    image->mapped = 0;
+
+    int result = image_check(image);
+    if (result != 0) {
+        story_image_close(image);
+    }
+    return result;
+}
+
+void story_image_close(StoryImage *image) {
+    if (image->mapped) {
+        munmap(image->data, image->size);
+    } else {
+        free(image->data);
+    }
+    memset(image, 0, sizeof(*image));
+}
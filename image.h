@@ -0,0 +1,92 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "story.h"
+#include "strbuf.h"
+
+/*
+ * Compiled story image (.storyc).
+ *
+ * A flat, versioned file that is used in place once mapped: a header,
+ * then the arrays of StoryTables one after the other, then a blob of
+ * NUL-terminated strings. The arrays are laid out exactly as in memory,
+ * with every string ref an offset into the blob, so loading is an mmap
+ * plus a bounds check. The StoryTables of a loaded image point straight
+ * into the mapping, with no copy and no pointer fixups, and several
+ * processes mapping the same file share its pages.
+ *
+ * Everything is in declaration order. A room's choices and a choice's
+ * options are contiguous ranges of their arrays, and each option's goto
+ * target is already resolved to a room index. The item slots place item
+ * IDs by the XXH64 of their names with linear probing (see
+ * story_find_item()). Integers are stored in the writer's byte order; the
+ * loader rejects images from the other one.
+ */
+
+#define STORY_IMAGE_MAGIC "STYC"
+#define STORY_IMAGE_VERSION 4
+#define STORY_IMAGE_BYTE_ORDER 0x01020304u
+
+#define STORY_NO_STRING UINT64_MAX   // absent string (untitled story)
+
+typedef struct StoryImageHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t room_count;
+    uint32_t choice_count;
+    uint32_t option_count;
+    uint32_t item_count;
+    uint32_t item_slot_count; // power of two, 0 without items
+    uint64_t title;           // string offset
+    // Byte offsets from the start of the image of the StoryTables arrays
+    uint64_t room_name;
+    uint64_t room_description;
+    uint64_t room_first_choice;
+    uint64_t room_first_option;
+    uint64_t room_ending;
+    uint64_t choice_text;
+    uint64_t choice_first_option;
+    uint64_t option_text;
+    uint64_t option_target_name;
+    uint64_t option_target;
+    uint64_t item_name;
+    uint64_t item_description;
+    uint64_t item_slots;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+} StoryImageHeader;
+
+/* A loaded image; the arrays of its tables point into the mapping */
+typedef struct StoryImage {
+    const StoryImageHeader *header;
+    StoryTables tables;       // read-only, and not to be freed
+    const char *strings;
+    void *data;
+    size_t size;
+    int mapped;               // data is an mmap rather than a malloc'd block
+} StoryImage;
+
+/* Serializes the tables of `story` into `out`; returns 0 */
+int story_image_build(const Story *story, StrBuf *out);
+
+/*
+ * Maps the image at `path` and checks it. Returns 0 on success, -1 if the
+ * file cannot be read and -2 if it is not a valid image.
+ */
+int story_image_load(StoryImage *image, const char *path);
+
+/* Same as story_image_load() for an image in a malloc'd block, which the
+ * image takes over */
+int story_image_from_buffer(StoryImage *image, void *data, size_t size);
+
+void story_image_close(StoryImage *image);
+
+static inline const char *story_image_string(const StoryImage *image,
+                                             uint64_t offset) {
+    return offset == STORY_NO_STRING ? NULL : image->strings + offset;
+}
+
+#endif /* IMAGE_H */
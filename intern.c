@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "stats.h"
+
+#define INTERN_MIN_CAPACITY 256
+
+struct InternEntry {
+    const char *str;   // NULL marks an empty slot
+    size_t len;
+    unsigned long hash;
+};
+
+// FNV-1a
+static unsigned long intern_hash(const char *s, size_t len) {
+    unsigned long hash = 2166136261UL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)s[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+static void intern_grow(InternPool *pool) {
+    size_t capacity = pool->capacity ? pool->capacity * 2 : INTERN_MIN_CAPACITY;
+    InternEntry *entries = (InternEntry *)calloc(capacity, sizeof(InternEntry));
+    if (!entries) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < pool->capacity; i++) {
+        InternEntry *old = &pool->entries[i];
+        if (!old->str) continue;
+
+        size_t j = old->hash & (capacity - 1);
+        while (entries[j].str) {
+            j = (j + 1) & (capacity - 1);
+        }
+        entries[j] = *old;
+    }
+
+    free(pool->entries);
+    pool->entries = entries;
+    pool->capacity = capacity;
+}
+
+void intern_init(InternPool *pool, Arena *arena) {
+    pool->entries = NULL;
+    pool->capacity = 0;
+    pool->count = 0;
+    pool->arena = arena;
+}
+
+void intern_free(InternPool *pool) {
+    // The strings themselves belong to the arena
+    free(pool->entries);
+    pool->entries = NULL;
+    pool->capacity = 0;
+    pool->count = 0;
+}
+
+const char *intern_string(InternPool *pool, const char *s, size_t len) {
+    if ((pool->count + 1) * 4 > pool->capacity * 3) {
+        intern_grow(pool);
+    }
+
+    STATS_ADD(intern_lookups, 1);
+    unsigned long hash = intern_hash(s, len);
+    size_t mask = pool->capacity - 1;
+    size_t i = hash & mask;
+
+    while (pool->entries[i].str) {
+        InternEntry *entry = &pool->entries[i];
+        if (entry->hash == hash && entry->len == len) {
+            STATS_ADD(intern_compares, 1);
+            if (memcmp(entry->str, s, len) == 0) {
+                return entry->str;
+            }
+        }
+        i = (i + 1) & mask;
+    }
+
+    InternEntry *entry = &pool->entries[i];
+    entry->str = arena_strndup(pool->arena, s, len);
+    entry->len = len;
+    entry->hash = hash;
+    pool->count++;
+    return entry->str;
+}
+
+const char *intern_cstring(InternPool *pool, const char *s) {
+    return intern_string(pool, s, strlen(s));
+}
@@ -0,0 +1,30 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include "arena.h"
+
+/*
+ * String interning pool shared by the lexer and the grammar actions.
+ *
+ * Each distinct string is stored once in the owning arena and handed out
+ * as a stable `const char *` atom: interning the same bytes again returns
+ * the same pointer, so atoms can be compared with == and hashed by address.
+ */
+
+typedef struct InternEntry InternEntry;
+
+typedef struct InternPool {
+    InternEntry *entries;
+    size_t capacity;
+    size_t count;
+    Arena *arena;   // where the interned bytes live
+} InternPool;
+
+void intern_init(InternPool *pool, Arena *arena);
+void intern_free(InternPool *pool);
+
+const char *intern_string(InternPool *pool, const char *s, size_t len);
+const char *intern_cstring(InternPool *pool, const char *s);
+
+#endif /* INTERN_H */
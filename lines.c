@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lines.h"
+
+void line_index_init(LineIndex *index, size_t start) {
+    index->newlines = NULL;
+    index->count = 0;
+    index->capacity = 0;
+    index->dropped = 0;
+    index->line_start = start;
+    index->built = 0;
+}
+
+void line_index_free(LineIndex *index) {
+    free(index->newlines);
+    line_index_init(index, 0);
+}
+
+void line_index_add(LineIndex *index, const char *text, size_t len, size_t offset) {
+    if (len == 0) return;
+    const char *end = text + len;
+    for (const char *nl = memchr(text, '\n', len); nl; nl = memchr(nl + 1, '\n', end - nl - 1)) {
+        if (index->count == index->capacity) {
+            index->capacity = index->capacity ? index->capacity * 2 : 256;
+            index->newlines = (size_t *)realloc(index->newlines,
+                                                index->capacity * sizeof(size_t));
+            if (!index->newlines) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+        }
+        index->newlines[index->count++] = offset + (size_t)(nl - text);
+    }
+}
+
+// Newlines recorded before `offset`
+static size_t lines_before(const LineIndex *index, size_t offset) {
+    size_t low = 0, high = index->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (index->newlines[mid] < offset) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+void line_index_drop(LineIndex *index, size_t offset) {
+    size_t n = lines_before(index, offset);
+    if (n == 0) return;
+    index->line_start = index->newlines[n - 1] + 1;
+    index->dropped += (int)n;
+    index->count -= n;
+    memmove(index->newlines, index->newlines + n, index->count * sizeof(size_t));
+}
+
+void line_index_locate(const LineIndex *index, size_t offset, int *line, int *column) {
+    size_t n = lines_before(index, offset);
+    size_t start = n ? index->newlines[n - 1] + 1 : index->line_start;
+    *line = index->dropped + (int)n;
+    *column = (int)(offset - start) + 1;
+}
+
+int count_lines(const char *text, size_t len) {
+    int lines = 0;
+    if (len == 0) return 0;
+    const char *end = text + len;
+    for (const char *nl = memchr(text, '\n', len); nl; nl = memchr(nl + 1, '\n', end - nl - 1)) {
+        lines++;
+    }
+    return lines;
+}
@@ -0,0 +1,41 @@
+#ifndef LINES_H
+#define LINES_H
+
+#include <stddef.h>
+
+/*
+ * Newline index for turning byte offsets into lines and columns.
+ *
+ * The lexer and the story nodes only keep byte offsets; lines are worked
+ * out when a message needs one, from the newlines recorded here. They are
+ * recorded all at once the first time (line_index_add() over the whole
+ * text), or as text streams past, dropping the ones that are no longer
+ * needed so the index stays as small as the text being looked at.
+ */
+
+typedef struct LineIndex {
+    size_t *newlines;      // offsets of the recorded newlines, ascending
+    size_t count;
+    size_t capacity;
+    int dropped;           // newlines forgotten by line_index_drop()
+    size_t line_start;     // where the line after them starts
+    int built;             // set by the owner once the text has been added
+} LineIndex;
+
+/* An empty index for text that starts at offset `start`, on its first line */
+void line_index_init(LineIndex *index, size_t start);
+void line_index_free(LineIndex *index);
+
+/* Records the newlines of `len` bytes of `text`, which start at `offset` */
+void line_index_add(LineIndex *index, const char *text, size_t len, size_t offset);
+
+/* Forgets the newlines before `offset`; later lookups must not go before it */
+void line_index_drop(LineIndex *index, size_t offset);
+
+/* 0-based line (counted from the start of the text) and 1-based column of `offset` */
+void line_index_locate(const LineIndex *index, size_t offset, int *line, int *column);
+
+/* Newlines in the `len` bytes at `text` */
+int count_lines(const char *text, size_t len);
+
+#endif /* LINES_H */
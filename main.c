@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "analyze.h"
+#include "batch.h"
+#include "cache.h"
+#include "export.h"
+#include "image.h"
+#include "runtime.h"
+#include "stats.h"
+#include "story.h"
+#include "threadpool.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-q | -v] [--jobs N] [--stats] [--json | --analyze | --play | --compile out.storyc] [--cache DIR] [--max-errors N] [file.story | file.storyc | directory]\n", prog);
+}
+
+static int is_directory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+static int is_image_file(const char *path) {
+    size_t len = strlen(path);
+    return len > 7 && strcmp(path + len - 7, ".storyc") == 0;
+}
+
+// What to do with the story once it is parsed (or found in the cache)
+typedef struct Output {
+    StoryFormat format;
+    int analyze;               // print the graph analysis instead of the story
+    int play;                  // play it on stdin and stdout
+    const char *compile_path;  // write an image instead of printing
+} Output;
+
+// Prints the story or its analysis, or plays it; an analysis that finds
+// problems fails
+static int print_tables(const char *title, const StoryTables *tables,
+                        const Output *output) {
+    if (output->play) {
+        story_play(title, tables, stdin, stdout);
+        return 0;
+    }
+    if (output->analyze) {
+        StoryAnalysis analysis;
+        story_analyze(tables, &analysis);
+        uint32_t problems = story_analysis_print(tables, &analysis, stdout);
+        story_analysis_free(&analysis);
+        return problems ? 1 : 0;
+    }
+    if (story_export_tables(title, tables, output->format, stdout) != 0) {
+        fprintf(stderr, "Error: Cannot write output\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Prints a compiled story, reading its strings in place
+static int print_image(const StoryImage *image, const Output *output) {
+    return print_tables(story_image_string(image, image->header->title),
+                        &image->tables, output);
+}
+
+static int print_image_file(const char *path, const Output *output) {
+    StoryImage image;
+    int result = story_image_load(&image, path);
+    if (result == -1) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", path);
+        return 1;
+    }
+    if (result != 0) {
+        fprintf(stderr, "Error: '%s' is not a valid compiled story\n", path);
+        return 1;
+    }
+    result = print_image(&image, output);
+    story_image_close(&image);
+    return result;
+}
+
+static int write_image(const char *path, const char *data, size_t len) {
+    if (write_file_atomic(path, data, len) != 0) {
+        fprintf(stderr, "Error: Cannot write '%s'\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+// Does what a parse of the cached text would have done, from the entry
+static int replay_cache_entry(const StoryCacheEntry *entry, FILE *notes,
+                              const char *name, const Output *output) {
+    fwrite(entry->notes, 1, entry->notes_len, notes);
+    fflush(notes);
+    fwrite(entry->errors, 1, entry->errors_len, stderr);
+
+    if (!output->compile_path) {
+        return print_image(&entry->image, output);
+    }
+    if (entry->failed) {
+        fprintf(stderr, "Error: Not compiling '%s', it has errors\n", name);
+        return 1;
+    }
+    return write_image(output->compile_path, (const char *)entry->image.data,
+                       entry->image.size);
+}
+
+static FILE *open_capture(char **data, size_t *len) {
+    FILE *stream = open_memstream(data, len);
+    if (!stream) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return stream;
+}
+
+// Loads the whole input: regular files are mapped, anything else (pipes,
+// devices, stdin) is read through stdio
+static int load_source(SourceBuffer *source, const char *path) {
+    if (path && source_map_file(source, path) == 0) {
+        return 0;
+    }
+
+    FILE *input = path ? fopen(path, "r") : stdin;
+    if (!input) {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", path);
+        return -1;
+    }
+    int result = source_read_stream(source, input);
+    if (result != 0) {
+        fprintf(stderr, "Error: Cannot read '%s'\n", path ? path : "<stdin>");
+    }
+    if (path) fclose(input);
+    return result;
+}
+
+// Parses the story in `source` and prints or compiles it; with a cache the
+// messages are captured, so they can be stored along with the image
+static int parse_and_output(SourceBuffer *source, const char *name, DiagLevel level,
+                            int jobs, int max_errors, FILE *notes, const Output *output,
+                            const char *cache_dir, uint64_t key) {
+    StoryParseCtx ctx;
+    StoryCacheEntry fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    story_parse_ctx_init(&ctx, name);
+    ctx.diag.level = level;
+    ctx.jobs = jobs;
+    ctx.max_errors = max_errors;
+    ctx.diag.out = cache_dir ? open_capture(&fresh.notes, &fresh.notes_len) : notes;
+    ctx.diag.err = cache_dir ? open_capture(&fresh.errors, &fresh.errors_len) : stderr;
+    size_t text_len = source->len;
+    int errors = storyscript_parse_source(source, &ctx);
+
+    StrBuf image;
+    strbuf_init(&image);
+    int have_image = (cache_dir || output->compile_path) && story_image_build(ctx.story, &image) == 0;
+    int result = 0;
+
+    if (cache_dir) {
+        fclose(ctx.diag.out);
+        fclose(ctx.diag.err);
+        ctx.diag.out = NULL;
+        ctx.diag.err = NULL;
+        fresh.failed = errors;
+        fwrite(fresh.notes, 1, fresh.notes_len, notes);
+        fflush(notes);
+        fwrite(fresh.errors, 1, fresh.errors_len, stderr);
+        // The key only covers this file's text, so stories with includes
+        // are not cached
+        if (have_image && !ctx.story->modules) {
+            story_cache_store(cache_dir, key, text_len, &fresh, &image);
+        }
+    }
+
+    // Compile, or print, and cleanup
+    if (output->compile_path) {
+        if (errors) {
+            fprintf(stderr, "Error: Not compiling '%s', it has errors\n", name);
+            result = 1;
+        } else if (!have_image) {
+            fprintf(stderr, "Error: Story is too large for a compiled image\n");
+            result = 1;
+        } else {
+            result = write_image(output->compile_path, image.data, image.len);
+        }
+    } else {
+        result = print_tables(ctx.story->title, &ctx.story->tables, output);
+    }
+    strbuf_free(&image);
+    story_cache_entry_free(&fresh);
+    free_story(ctx.story);
+    story_parse_ctx_free(&ctx);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    const char *path = NULL;
+    Output output = { STORY_FORMAT_TEXT, 0, 0, NULL };
+    const char *cache_dir = NULL;
+    DiagLevel level = DIAG_NOTE;
+    int show_stats = 0;
+    int jobs = 0;
+    int max_errors = STORY_MAX_ERRORS;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--jobs") == 0 || strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc || (jobs = atoi(argv[++i])) < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-errors") == 0) {
+            if (i + 1 >= argc || (max_errors = atoi(argv[++i])) < 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--quiet") == 0 || strcmp(argv[i], "-q") == 0) {
+            level = DIAG_ERROR;
+        } else if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+            level = DIAG_VERBOSE;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            show_stats = 1;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            output.format = STORY_FORMAT_JSON;
+        } else if (strcmp(argv[i], "--analyze") == 0) {
+            output.analyze = 1;
+        } else if (strcmp(argv[i], "--play") == 0) {
+            output.play = 1;
+        } else if (strcmp(argv[i], "--compile") == 0 || strcmp(argv[i], "-c") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            output.compile_path = argv[++i];
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            cache_dir = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(argv[0]);
+            return 1;
+        } else if (!path) {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // These all replace the listing, so only one of them at a time; playing
+    // reads the player's input from stdin, so the story must be a file
+    if ((output.compile_path != NULL) + (output.format != STORY_FORMAT_TEXT) +
+        output.analyze + output.play > 1 || (output.play && !path)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // A directory is checked file by file instead of printed
+    if (path && is_directory(path)) {
+        if (output.compile_path || output.format != STORY_FORMAT_TEXT || output.analyze ||
+            output.play || show_stats || cache_dir) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (jobs == 0) jobs = threadpool_default_jobs();
+        return batch_check(path, jobs, max_errors) ? 1 : 0;
+    }
+
+    if (path && !output.compile_path && is_image_file(path)) {
+        if (show_stats || cache_dir) {
+            usage(argv[0]);
+            return 1;
+        }
+        return print_image_file(path, &output);
+    }
+
+    // Keep stdout clean for the JSON document
+    FILE *notes = output.format == STORY_FORMAT_JSON ? stderr : stdout;
+
+#ifdef STORYSCRIPT_STATS
+    StoryStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (show_stats) story_stats = &stats;
+#else
+    if (show_stats) {
+        fprintf(stderr, "Error: This build has no counters; build with 'make stats'\n");
+        return 1;
+    }
+#endif
+
+    SourceBuffer source;
+    source_init(&source);
+
+    // Check for input file
+    if (!path && level >= DIAG_NOTE) {
+        fprintf(notes, "Reading from standard input...\n");
+    }
+    if (load_source(&source, path) != 0) {
+        return 1;
+    }
+
+    // A cache hit skips the lexer and the parser entirely
+    const char *name = path ? path : "<stdin>";
+    uint64_t key = 0;
+    StoryCacheEntry entry;
+    int result;
+    if (cache_dir) {
+        key = story_cache_key(source.data, source.len, name, level, max_errors);
+    }
+    if (cache_dir && story_cache_lookup(cache_dir, key, source.len, &entry) == 0) {
+        source_release(&source);
+        result = replay_cache_entry(&entry, notes, name, &output);
+        story_cache_entry_free(&entry);
+    } else {
+        result = parse_and_output(&source, name, level, jobs, max_errors, notes, &output, cache_dir, key);
+    }
+
+#ifdef STORYSCRIPT_STATS
+    if (show_stats) stats_print(&stats, stderr);
+#endif
+    return result;
+}
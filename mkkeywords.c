@@ -0,0 +1,108 @@
+/*
+ * Keyword classifier generator for the lexer.
+ *
+ * The lexer matches keywords and identifiers with one rule and asks
+ * keyword_token() which keyword, if any, it matched. This program finds a
+ * perfect hash over the keywords below, gperf style: a slot computed from
+ * the length and the first and last bytes, with multipliers searched until
+ * no two keywords share a slot. It writes keywords.h to stdout, with the
+ * slot table and keyword_token(): one hash, one length check and one
+ * memcmp per identifier, whatever the number of keywords.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const struct { const char *name; const char *token; } keywords[] = {
+    { "story", "STORY" },
+    { "room", "ROOM" },
+    { "title", "TITLE" },
+    { "inventory", "INVENTORY" },
+    { "item", "ITEM" },
+    { "description", "DESCRIPTION" },
+    { "choice", "CHOICE" },
+    { "option", "OPTION" },
+    { "goto", "GOTO" },
+    { "ending", "ENDING" },
+    { "include", "INCLUDE" },
+};
+
+#define KEYWORD_COUNT (sizeof(keywords) / sizeof(keywords[0]))
+#define MAX_SLOTS 256
+
+static unsigned slot_of(const char *name, unsigned first, unsigned last, unsigned slots) {
+    size_t len = strlen(name);
+    return ((unsigned char)name[0] * first + (unsigned char)name[len - 1] * last +
+            (unsigned)len) & (slots - 1);
+}
+
+// Multipliers under which every keyword lands in its own slot
+static int search(unsigned slots, unsigned *first, unsigned *last) {
+    for (unsigned a = 1; a < 256; a++) {
+        for (unsigned b = 0; b < 256; b++) {
+            unsigned char used[MAX_SLOTS] = { 0 };
+            size_t k;
+            for (k = 0; k < KEYWORD_COUNT; k++) {
+                unsigned slot = slot_of(keywords[k].name, a, b, slots);
+                if (used[slot]) break;
+                used[slot] = 1;
+            }
+            if (k == KEYWORD_COUNT) {
+                *first = a;
+                *last = b;
+                return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+int main(void) {
+    size_t min_len = (size_t)-1, max_len = 0;
+    for (size_t k = 0; k < KEYWORD_COUNT; k++) {
+        size_t len = strlen(keywords[k].name);
+        if (len < min_len) min_len = len;
+        if (len > max_len) max_len = len;
+    }
+
+    // The smallest power of two that works keeps the table in a cache line or two
+    unsigned slots, first = 0, last = 0;
+    for (slots = 1; slots < KEYWORD_COUNT; slots *= 2) {}
+    while (slots <= MAX_SLOTS && search(slots, &first, &last) != 0) slots *= 2;
+    if (slots > MAX_SLOTS) {
+        fprintf(stderr, "Error: No perfect hash for the keywords\n");
+        return 1;
+    }
+
+    const char *table[MAX_SLOTS] = { 0 };
+    size_t index[MAX_SLOTS];
+    for (size_t k = 0; k < KEYWORD_COUNT; k++) {
+        unsigned slot = slot_of(keywords[k].name, first, last, slots);
+        table[slot] = keywords[k].name;
+        index[slot] = k;
+    }
+
+    printf("/* Generated by mkkeywords; do not edit */\n");
+    printf("#ifndef KEYWORDS_H\n#define KEYWORDS_H\n\n");
+    printf("#include <stddef.h>\n#include <string.h>\n#include \"parser.h\"\n\n");
+    printf("static const struct { char name[%zu]; unsigned char len; int token; } keyword_slots[%u] = {\n",
+           max_len + 1, slots);
+    for (unsigned s = 0; s < slots; s++) {
+        if (table[s]) {
+            printf("    { \"%s\", %zu, %s },\n", table[s], strlen(table[s]), keywords[index[s]].token);
+        } else {
+            printf("    { \"\", 0, 0 },\n");
+        }
+    }
+    printf("};\n\n");
+    printf("/* Token of the keyword spelled by the `len` bytes at `s`, or 0 for an identifier */\n");
+    printf("static inline int keyword_token(const char *s, size_t len) {\n");
+    printf("    if (len < %zu || len > %zu) return 0;\n", min_len, max_len);
+    printf("    unsigned slot = ((unsigned char)s[0] * %uu + (unsigned char)s[len - 1] * %uu +\n",
+           first, last);
+    printf("                     (unsigned)len) & %uu;\n", slots - 1);
+    printf("    return keyword_slots[slot].len == len && memcmp(keyword_slots[slot].name, s, len) == 0\n");
+    printf("               ? keyword_slots[slot].token : 0;\n");
+    printf("}\n\n#endif /* KEYWORDS_H */\n");
+    return 0;
+}
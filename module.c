@@ -0,0 +1,171 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "module.h"
+#include "threadpool.h"
+
+typedef struct ModuleJob {
+    char *path;           // file to parse, relative to the working directory
+    char *from;           // file that included it, for messages
+    Story *includer;      // and its story, which keeps the include's text
+    size_t offset;        // of the include
+    Story *story;         // NULL if the file cannot be read
+    int errors;
+    char *notes;          // what the parse wrote to each stream
+    size_t notes_len;
+    char *messages;
+    size_t messages_len;
+} ModuleJob;
+
+typedef struct ModuleWave {
+    ModuleJob *jobs;
+    size_t count;
+    size_t capacity;
+    DiagLevel level;
+    int max_errors;
+} ModuleWave;
+
+static char *join_path(const char *from, const char *path) {
+    const char *slash = strrchr(from, '/');
+    size_t dir_len = path[0] == '/' || !slash ? 0 : (size_t)(slash - from) + 1;
+    char *joined = (char *)malloc(dir_len + strlen(path) + 1);
+    if (!joined) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(joined, from, dir_len);
+    strcpy(joined + dir_len, path);
+    return joined;
+}
+
+// True the first time a file is seen; files are told apart by their real
+// path, or by the name they were included as if that cannot be resolved
+static int first_visit(InternPool *seen, const char *path) {
+    char *real = realpath(path, NULL);
+    size_t count = seen->count;
+    intern_cstring(seen, real ? real : path);
+    free(real);
+    return seen->count != count;
+}
+
+// Queues the includes of `story`, in source order
+static void queue_includes(ModuleWave *wave, InternPool *seen, Story *story,
+                           const char *from) {
+    size_t start = wave->count;
+    for (const StoryInclude *include = story->includes; include; include = include->next) {
+        char *path = join_path(from, include->path);
+        if (!first_visit(seen, path)) {
+            free(path);
+            continue;
+        }
+
+        if (wave->count == wave->capacity) {
+            wave->capacity = wave->capacity ? wave->capacity * 2 : 16;
+            wave->jobs = (ModuleJob *)realloc(wave->jobs, wave->capacity * sizeof(ModuleJob));
+            if (!wave->jobs) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+        }
+        ModuleJob *job = &wave->jobs[wave->count++];
+        memset(job, 0, sizeof(*job));
+        job->path = path;
+        job->from = strdup(from);
+        job->includer = story;
+        job->offset = include->offset;
+    }
+
+    // The list is newest first
+    for (size_t i = start, j = wave->count; i + 1 < j; i++, j--) {
+        ModuleJob tmp = wave->jobs[i];
+        wave->jobs[i] = wave->jobs[j - 1];
+        wave->jobs[j - 1] = tmp;
+    }
+}
+
+static FILE *open_capture(char **data, size_t *len) {
+    FILE *stream = open_memstream(data, len);
+    if (!stream) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return stream;
+}
+
+static void parse_module(size_t index, void *arg) {
+    ModuleWave *wave = (ModuleWave *)arg;
+    ModuleJob *job = &wave->jobs[index];
+
+    SourceBuffer source;
+    source_init(&source);
+    if (source_map_file(&source, job->path) != 0) return;
+
+    // Messages are captured and replayed in include order
+    FILE *out = open_capture(&job->notes, &job->notes_len);
+    FILE *err = open_capture(&job->messages, &job->messages_len);
+    StoryParseCtx ctx;
+    story_parse_ctx_init(&ctx, job->path);
+    ctx.module = 1;
+    ctx.diag.level = wave->level;
+    ctx.max_errors = wave->max_errors;
+    ctx.diag.out = out;
+    ctx.diag.err = err;
+    if (storyscript_parse_source(&source, &ctx) != 0 && ctx.errors == 0) {
+        ctx.errors = 1;
+    }
+    job->story = ctx.story;
+    job->errors = ctx.errors;
+    story_parse_ctx_free(&ctx);
+    fclose(out);
+    fclose(err);
+}
+
+static void free_wave(ModuleWave *wave) {
+    for (size_t i = 0; i < wave->count; i++) {
+        free(wave->jobs[i].path);
+        free(wave->jobs[i].from);
+        free(wave->jobs[i].notes);
+        free(wave->jobs[i].messages);
+    }
+    free(wave->jobs);
+}
+
+void story_load_modules(StoryParseCtx *ctx) {
+    Arena arena;
+    InternPool seen;
+    arena_init(&arena);
+    intern_init(&seen, &arena);
+    first_visit(&seen, ctx->filename);
+
+    ModuleWave wave = { NULL, 0, 0, ctx->diag.level, ctx->max_errors };
+    queue_includes(&wave, &seen, ctx->story, ctx->filename);
+
+    int jobs = ctx->jobs > 0 ? ctx->jobs : threadpool_default_jobs();
+    while (wave.count > 0) {
+        threadpool_run(wave.count, jobs, parse_module, &wave);
+
+        ModuleWave next = { NULL, 0, 0, ctx->diag.level, ctx->max_errors };
+        for (size_t i = 0; i < wave.count; i++) {
+            ModuleJob *job = &wave.jobs[i];
+            if (!job->story) {
+                DIAG(&ctx->diag, DIAG_ERROR, "Error in %s at line %d: Cannot open included file '%s'\n",
+                     job->from, story_line_at(job->includer, job->offset), job->path);
+                ctx->errors++;
+                continue;
+            }
+            diag_write(&ctx->diag, DIAG_NOTE, job->notes, job->notes_len);
+            diag_write(&ctx->diag, DIAG_ERROR, job->messages, job->messages_len);
+            ctx->errors += job->errors;
+
+            queue_includes(&next, &seen, job->story, job->path);
+            story_merge_module(ctx, job->story, job->path);
+        }
+        free_wave(&wave);
+        wave = next;
+    }
+    free_wave(&wave);
+
+    intern_free(&seen);
+    arena_free(&arena);
+}
@@ -0,0 +1,22 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include "story.h"
+
+/*
+ * Multi-file stories. A file names others with include "path"; (relative
+ * to the including file), and their rooms and items join the story, so a
+ * goto in one file can target a room in another.
+ *
+ * Included files are parsed in waves: all the files the previous wave
+ * included, each into a story of its own on ctx->jobs threads. The waves
+ * are then merged into ctx->story in include order, so the result and
+ * its messages do not depend on scheduling, and the caller links the
+ * whole story once at the end. Every file is read once however often it
+ * is included, which also stops include cycles.
+ */
+
+/* Loads everything ctx->story includes, directly or not; errors go to ctx */
+void story_load_modules(StoryParseCtx *ctx);
+
+#endif /* MODULE_H */
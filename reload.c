@@ -0,0 +1,148 @@
+/*
+ * Hot reload stress test for host.h (make reload-stress).
+ *
+ * Loads the images named on the command line into one StoryHost round
+ * robin, -l times in all, while -r reader threads play batches of
+ * sessions and call story_reader_update() every tick the way a server's
+ * workers would. Every tick checks that each session is in a room of the
+ * reader's version, or in none, and holds only items that version has,
+ * and reads the name of its room. A version freed while a reader can
+ * still see it shows up under ASan, and a missing barrier between the
+ * loader and the readers under ThreadSanitizer; either way, and on a
+ * failed check, the program aborts.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "host.h"
+
+#define RELOAD_SESSIONS 256        // sessions of each reader
+#define RELOAD_MAX_READERS 64
+
+static StoryHost *host;
+static atomic_int stopping;
+static atomic_long ticks;
+static atomic_long updates;
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-r readers] [-l loads] image.storyc...\n", prog);
+}
+
+static void check(int ok, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "Error: %s\n", what);
+        abort();
+    }
+}
+
+static int load(const char *path) {
+    int result = story_host_load(host, path);
+    if (result == -3) {
+        fprintf(stderr, "Error: '%s' has more items than a session can hold\n", path);
+    } else if (result != 0) {
+        fprintf(stderr, "Error: Cannot load '%s'\n", path);
+    }
+    return result;
+}
+
+// xorshift32, so readers draw options without sharing any state
+static uint32_t next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void *play(void *arg) {
+    uint32_t seed = (uint32_t)(uintptr_t)arg;
+    StorySession sessions[RELOAD_SESSIONS];
+    uint32_t options[RELOAD_SESSIONS];
+
+    StoryReader *reader = story_host_join(host);
+    check(reader != NULL, "reader cannot join");
+    for (int i = 0; i < RELOAD_SESSIONS; i++) {
+        story_session_start(story_reader_runtime(reader), &sessions[i]);
+    }
+
+    long played = 0, moved = 0;
+    while (!atomic_load_explicit(&stopping, memory_order_relaxed)) {
+        moved += story_reader_update(reader, sessions, RELOAD_SESSIONS);
+        const StoryRuntime *runtime = story_reader_runtime(reader);
+        const StoryTables *tables = story_reader_tables(reader);
+
+        for (int i = 0; i < RELOAD_SESSIONS; i++) {
+            StorySession *session = &sessions[i];
+            check(session->room == STORY_NO_ROOM || session->room < tables->room_count,
+                  "session in a room of another version");
+            check(tables->item_count >= STORY_SESSION_MAX_ITEMS ||
+                  (session->inventory >> tables->item_count) == 0,
+                  "session holds an item of another version");
+            if (story_session_finished(runtime, session)) {
+                story_session_start(runtime, session);
+            }
+            if (session->room != STORY_NO_ROOM) {
+                check(story_string(tables, tables->room_name[session->room])[0] != '\0',
+                      "room without a name");
+            }
+            if (tables->item_count && next_random(&seed) % 8 == 0) {
+                story_session_give(session, next_random(&seed) % tables->item_count);
+            }
+            options[i] = next_random(&seed) % 4;
+        }
+        story_step_batch(runtime, sessions, options, RELOAD_SESSIONS);
+        played++;
+    }
+
+    story_reader_leave(reader);
+    atomic_fetch_add(&ticks, played);
+    atomic_fetch_add(&updates, moved);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int readers = 4;
+    long loads = 1000;
+    int first = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            readers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            loads = atol(argv[++i]);
+        } else {
+            first = i;
+            break;
+        }
+    }
+    if (first == argc || readers < 1 || readers > RELOAD_MAX_READERS || loads < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    int images = argc - first;
+
+    host = story_host_create((size_t)readers);
+    if (load(argv[first]) != 0) return 1;
+
+    pthread_t threads[RELOAD_MAX_READERS];
+    for (int i = 0; i < readers; i++) {
+        if (pthread_create(&threads[i], NULL, play, (void *)(uintptr_t)(i + 1)) != 0) {
+            fprintf(stderr, "Error: Cannot start reader thread\n");
+            return 1;
+        }
+    }
+    for (long i = 1; i <= loads; i++) {
+        if (load(argv[first + i % images]) != 0) return 1;
+    }
+    atomic_store(&stopping, 1);
+    for (int i = 0; i < readers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    check(story_host_generation(host) == (uint64_t)loads + 1, "a load was lost");
+    printf("%ld loads of %d images, %d readers: %ld ticks, %ld updates\n",
+           loads, images, readers, (long)ticks, (long)updates);
+    story_host_destroy(host);
+    return 0;
+}
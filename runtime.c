@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "runtime.h"
+
+int story_runtime_init(StoryRuntime *runtime, const StoryTables *tables) {
+    runtime->room_count = tables->room_count;
+    runtime->item_count = tables->item_count;
+    runtime->room_first_option = tables->room_first_option;
+    runtime->room_first_choice = tables->room_first_choice;
+    runtime->choice_first_option = tables->choice_first_option;
+    runtime->option_target = tables->option_target;
+    runtime->room_ending = tables->room_ending;
+    return tables->item_count > STORY_SESSION_MAX_ITEMS ? -1 : 0;
+}
+
+size_t story_step_batch(const StoryRuntime *runtime, StorySession *sessions,
+                        const uint32_t *options, size_t n) {
+    const uint32_t *first_option = runtime->room_first_option;
+    const uint32_t *option_target = runtime->option_target;
+    uint32_t room_count = runtime->room_count;
+    size_t moved = 0;
+
+    // Without options nobody can move, and below every index is clamped to
+    // a valid slot instead of branching, which needs a room and an option
+    if (room_count == 0 || first_option[room_count] == 0) return 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint32_t room = sessions[i].room;
+        uint32_t option = options[i];
+        uint32_t in_room = room < room_count;
+        uint32_t r = in_room ? room : 0;
+        uint32_t first = first_option[r];
+        uint32_t ok = in_room & (option < first_option[r + 1] - first);
+        uint32_t target = option_target[ok ? first + option : 0];
+        ok &= target != STORY_NO_ROOM;
+
+        sessions[i].room = ok ? target : room;
+        sessions[i].steps += ok;
+        moved += ok;
+    }
+    return moved;
+}
+
+static void show_room(const StoryTables *t, uint32_t r, FILE *out) {
+    fprintf(out, "\n== %s ==\n%s\n", story_string(t, t->room_name[r]),
+            story_string(t, t->room_description[r]));
+
+    // Options are numbered across the room's choices, as story_session_take() counts
+    uint32_t number = 1;
+    for (uint32_t c = t->room_first_choice[r]; c < t->room_first_choice[r + 1]; c++) {
+        fprintf(out, "\n%s\n", story_string(t, t->choice_text[c]));
+        for (uint32_t o = t->choice_first_option[c]; o < t->choice_first_option[c + 1]; o++) {
+            fprintf(out, "  %u. %s\n", number++, story_string(t, t->option_text[o]));
+        }
+    }
+}
+
+uint32_t story_play(const char *title, const StoryTables *tables, FILE *in, FILE *out) {
+    StoryRuntime runtime;
+    StorySession session;
+    story_runtime_init(&runtime, tables);   // items are not used while playing
+    story_session_start(&runtime, &session);
+
+    fprintf(out, "%s\n", title ? title : "(untitled)");
+    if (session.room == STORY_NO_ROOM) {
+        fprintf(out, "No rooms defined\n");
+        return 0;
+    }
+
+    char line[64];
+    show_room(tables, session.room, out);
+    while (!story_session_finished(&runtime, &session)) {
+        uint32_t count = story_session_option_count(&runtime, &session);
+        fprintf(out, "> ");
+        fflush(out);
+        if (!fgets(line, sizeof(line), in) || line[0] == 'q') {
+            fprintf(out, "\n");
+            return session.steps;
+        }
+        if (!strchr(line, '\n')) {
+            // Drop the rest of an overlong line instead of reading it as input
+            int ch;
+            while ((ch = fgetc(in)) != EOF && ch != '\n') {}
+        }
+
+        char *end;
+        unsigned long number = strtoul(line, &end, 10);
+        if (end == line || number < 1 || number > count) {
+            fprintf(out, "Enter a number from 1 to %u, or q to quit\n", count);
+            continue;
+        }
+        if (story_session_take(&runtime, &session, (uint32_t)(number - 1)) != 0) {
+            fprintf(out, "That way leads nowhere\n");
+            continue;
+        }
+        show_room(tables, session.room, out);
+    }
+
+    fprintf(out, "\nThe End\n");
+    return session.steps;
+}
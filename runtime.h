@@ -0,0 +1,135 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "story.h"
+
+/*
+ * Story runtime: plays a finished story from its tables.
+ *
+ * A StoryRuntime is a read-only view of the arrays a step needs, shared by
+ * any number of sessions and threads. A StorySession is a 16-byte POD
+ * holding one player's state, so a server keeps them in a plain array and
+ * copies or stores them as bytes. Taking an option is two range checks
+ * and one load from the resolved option -> room table: no lookups, no
+ * allocation. A session whose room is not one of the runtime's (stored
+ * garbage, or a room of a bigger story) is treated like STORY_NO_ROOM:
+ * it has no options, cannot move and counts as finished, in the helpers
+ * below and in story_step_batch() alike.
+ */
+
+#define STORY_SESSION_MAX_ITEMS 64   // bits in the inventory
+
+typedef struct StoryRuntime {
+    uint32_t room_count;
+    uint32_t item_count;
+    const uint32_t *room_first_option;     // see StoryTables
+    const uint32_t *room_first_choice;
+    const uint32_t *choice_first_option;
+    const uint32_t *option_target;
+    const uint8_t *room_ending;
+} StoryRuntime;
+
+typedef struct StorySession {
+    uint32_t room;        // current room index, STORY_NO_ROOM if there is none
+    uint32_t steps;       // options taken so far
+    uint64_t inventory;   // bit i set: the player holds item i
+} StorySession;
+
+/*
+ * Points `runtime` at `tables`, which must outlive it. Returns 0, or -1 if
+ * the story has more items than a session's inventory can hold. The
+ * runtime still moves sessions around, but items from
+ * STORY_SESSION_MAX_ITEMS on can never be held, so a caller that plays
+ * with items should refuse such a story.
+ */
+int story_runtime_init(StoryRuntime *runtime, const StoryTables *tables);
+
+/* Puts `session` in the first room with nothing taken and no items */
+static inline void story_session_start(const StoryRuntime *runtime, StorySession *session) {
+    session->room = runtime->room_count ? 0 : STORY_NO_ROOM;
+    session->steps = 0;
+    session->inventory = 0;
+}
+
+/* Number of options in the current room, over all of its choices */
+static inline uint32_t story_session_option_count(const StoryRuntime *runtime,
+                                                  const StorySession *session) {
+    if (session->room >= runtime->room_count) return 0;
+    return runtime->room_first_option[session->room + 1] -
+           runtime->room_first_option[session->room];
+}
+
+/*
+ * Takes option `option` of the current room, counting across its choices
+ * in declaration order. Returns 0, or -1 (leaving the session as it was)
+ * if there is no such option or its goto was never resolved.
+ */
+static inline int story_session_take(const StoryRuntime *runtime, StorySession *session,
+                                     uint32_t option) {
+    if (option >= story_session_option_count(runtime, session)) return -1;
+    uint32_t target = runtime->option_target[runtime->room_first_option[session->room] + option];
+    if (target == STORY_NO_ROOM) return -1;
+    session->room = target;
+    session->steps++;
+    return 0;
+}
+
+/* Same, naming the option by its choice and its place in that choice */
+static inline int story_session_choose(const StoryRuntime *runtime, StorySession *session,
+                                       uint32_t choice, uint32_t option) {
+    if (session->room >= runtime->room_count) return -1;
+    uint32_t first_choice = runtime->room_first_choice[session->room];
+    if (choice >= runtime->room_first_choice[session->room + 1] - first_choice) return -1;
+
+    const uint32_t *first_option = runtime->choice_first_option;
+    uint32_t c = first_choice + choice;
+    if (option >= first_option[c + 1] - first_option[c]) return -1;
+    return story_session_take(runtime, session,
+                              first_option[c] - runtime->room_first_option[session->room] + option);
+}
+
+#define STORY_NO_OPTION UINT32_MAX   // no input for a session in a batch
+
+/*
+ * Steps a tick's worth of sessions: sessions[i] takes options[i], exactly
+ * as story_session_take() would, for every i < n. Sessions whose player
+ * sent nothing get STORY_NO_OPTION and stay where they are. The loop has
+ * no branches on the data and touches only the option tables, so it keeps
+ * them in cache and can be vectorized. Returns how many sessions moved.
+ */
+size_t story_step_batch(const StoryRuntime *runtime, StorySession *sessions,
+                        const uint32_t *options, size_t n);
+
+/* True once the session is in a declared ending or a room with no options */
+static inline int story_session_finished(const StoryRuntime *runtime,
+                                         const StorySession *session) {
+    return session->room >= runtime->room_count || runtime->room_ending[session->room] ||
+           story_session_option_count(runtime, session) == 0;
+}
+
+/* Gives the player `item`; returns 0, or -1 if no inventory can hold it */
+static inline int story_session_give(StorySession *session, uint32_t item) {
+    if (item >= STORY_SESSION_MAX_ITEMS) return -1;
+    session->inventory |= (uint64_t)1 << item;
+    return 0;
+}
+
+static inline void story_session_drop(StorySession *session, uint32_t item) {
+    if (item < STORY_SESSION_MAX_ITEMS) session->inventory &= ~((uint64_t)1 << item);
+}
+
+static inline int story_session_has(const StorySession *session, uint32_t item) {
+    return item < STORY_SESSION_MAX_ITEMS && (session->inventory >> item & 1);
+}
+
+/*
+ * Plays the story interactively: shows each room with its options
+ * numbered, reads a number per line from `in` until the story ends, the
+ * input does, or the player types "q". Returns the steps taken.
+ */
+uint32_t story_play(const char *title, const StoryTables *tables, FILE *in, FILE *out);
+
+#endif /* RUNTIME_H */
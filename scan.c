@@ -0,0 +1,93 @@
+#include <stdint.h>
+#include "scan.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Aligned loads past the terminating NUL stay within its page, but they
+// are outside the allocation as far as ASan is concerned
+#if defined(__GNUC__)
+#define NO_ASAN __attribute__((no_sanitize_address))
+#else
+#define NO_ASAN
+#endif
+
+#if defined(__AVX2__)
+
+NO_ASAN const char *scan_to(const char *p, char a, char b) {
+    const char *block = (const char *)((uintptr_t)p & ~(uintptr_t)31);
+    uint32_t live = ~0u << (p - block);   // bytes of the first block before p are not ours
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const __m256i vnul = _mm256_setzero_si256();
+
+    for (;;) {
+        __m256i v = _mm256_load_si256((const __m256i *)block);
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, va),
+                                                      _mm256_cmpeq_epi8(v, vb)),
+                                      _mm256_cmpeq_epi8(v, vnul));
+        uint32_t stop = (uint32_t)_mm256_movemask_epi8(hit) & live;
+        if (stop) return block + __builtin_ctz(stop);
+        live = ~0u;
+        block += 32;
+    }
+}
+
+#elif defined(__SSE2__)
+
+NO_ASAN const char *scan_to(const char *p, char a, char b) {
+    const char *block = (const char *)((uintptr_t)p & ~(uintptr_t)15);
+    uint32_t live = 0xffffu << (p - block) & 0xffffu;
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vnul = _mm_setzero_si128();
+
+    for (;;) {
+        __m128i v = _mm_load_si128((const __m128i *)block);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+                                   _mm_cmpeq_epi8(v, vnul));
+        uint32_t stop = (uint32_t)_mm_movemask_epi8(hit) & live;
+        if (stop) return block + __builtin_ctz(stop);
+        live = 0xffffu;
+        block += 16;
+    }
+}
+
+#elif defined(__ARM_NEON)
+
+// NEON has no movemask: narrowing the compare leaves four bits per byte
+static inline uint64_t nibble_mask(uint8x16_t eq) {
+    uint8x8_t narrow = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrow), 0);
+}
+
+NO_ASAN const char *scan_to(const char *p, char a, char b) {
+    const char *block = (const char *)((uintptr_t)p & ~(uintptr_t)15);
+    uint64_t live = ~0ull << 4 * (p - block);
+    const uint8x16_t va = vdupq_n_u8((uint8_t)a);
+    const uint8x16_t vb = vdupq_n_u8((uint8_t)b);
+    const uint8x16_t vnul = vdupq_n_u8(0);
+
+    for (;;) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)block);
+        uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb)), vceqq_u8(v, vnul));
+        uint64_t stop = nibble_mask(hit) & live;
+        if (stop) return block + __builtin_ctzll(stop) / 4;
+        live = ~0ull;
+        block += 16;
+    }
+}
+
+#else
+
+const char *scan_to(const char *p, char a, char b) {
+    while (*p != a && *p != b && *p != '\0') p++;
+    return p;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+/*
+ * Vector scanning for the lexer's long runs: string bodies and block
+ * comments, which is where most bytes of a story are. Uses AVX2 or SSE2
+ * on x86 and NEON on ARM, whichever the compiler targets, and a plain
+ * loop elsewhere.
+ */
+
+/*
+ * Returns the first byte at or after `p` that is `a`, `b` or NUL. The
+ * text must end in a NUL (flex's buffers end in two). Reads whole aligned
+ * blocks, so it may look at up to 31 bytes past that NUL, but never
+ * across a page boundary.
+ */
+const char *scan_to(const char *p, char a, char b);
+
+#endif /* SCAN_H */
@@ -0,0 +1,155 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source.h"
+
+void source_init(SourceBuffer *source) {
+    source->data = NULL;
+    source->len = 0;
+    source->map_len = 0;
+}
+
+int source_map_file(SourceBuffer *source, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+
+    // Only regular files can be mapped; pipes and ttys go through stdio
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t len = (size_t)st.st_size;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t map_len = (len + 2 + page - 1) & ~(page - 1);
+
+    // Reserve zeroed memory covering the text plus the two terminators, then
+    // map the file over the front of it. When the file ends exactly on a page
+    // boundary the NULs come from the anonymous page behind it, otherwise from
+    // the zero-filled tail of the file's last page.
+    char *data = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    if (len > 0 &&
+        mmap(data, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+             fd, 0) == MAP_FAILED) {
+        munmap(data, map_len);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    // The scan is a single sequential pass
+    madvise(data, map_len, MADV_SEQUENTIAL);
+
+    source->data = data;
+    source->len = len;
+    source->map_len = map_len;
+    return 0;
+}
+
+static char *source_alloc(size_t size) {
+    char *data = (char *)malloc(size);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return data;
+}
+
+int source_read_stream(SourceBuffer *source, FILE *stream) {
+    size_t cap = 64 * 1024;
+    size_t len = 0;
+    char *data = source_alloc(cap);
+
+    for (;;) {
+        // Always keep room for the two terminators
+        if (cap - len < 2 + 4096) {
+            cap *= 2;
+            char *bigger = (char *)realloc(data, cap);
+            if (!bigger) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            data = bigger;
+        }
+        size_t n = fread(data + len, 1, cap - len - 2, stream);
+        len += n;
+        if (n == 0) break;
+    }
+    if (ferror(stream)) {
+        free(data);
+        return -1;
+    }
+
+    data[len] = '\0';
+    data[len + 1] = '\0';
+    source->data = data;
+    source->len = len;
+    source->map_len = 0;
+    return 0;
+}
+
+void source_copy(SourceBuffer *source, const char *data, size_t len) {
+    source->data = source_alloc(len + 2);
+    memcpy(source->data, data, len);
+    source->data[len] = '\0';
+    source->data[len + 1] = '\0';
+    source->len = len;
+    source->map_len = 0;
+}
+
+void source_release(SourceBuffer *source) {
+    if (source->map_len) {
+        munmap(source->data, source->map_len);
+    } else {
+        free(source->data);
+    }
+    source_init(source);
+}
+
+int write_file_atomic(const char *path, const void *data, size_t len) {
+    // A unique name, so concurrent writers of the same path do not collide
+    size_t tmp_len = strlen(path) + 8;
+    char *tmp = (char *)malloc(tmp_len);
+    if (!tmp) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    snprintf(tmp, tmp_len, "%s.XXXXXX", path);
+
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        free(tmp);
+        return -1;
+    }
+
+    int ok = fchmod(fd, 0644) == 0;
+    const char *p = (const char *)data;
+    size_t left = len;
+    while (ok && left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            ok = 0;
+        } else {
+            p += n;
+            left -= (size_t)n;
+        }
+    }
+    if (close(fd) != 0) ok = 0;
+    if (ok && rename(tmp, path) != 0) ok = 0;
+    if (!ok) unlink(tmp);
+
+    free(tmp);
+    return ok ? 0 : -1;
+}
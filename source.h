@@ -0,0 +1,43 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Story source text held in memory for in-place scanning.
+ *
+ * The buffer is writable (a private, copy-on-write mapping of the file, or
+ * a malloc'd copy for streams and caller buffers) and is followed by the
+ * two NUL bytes flex's yy_scan_buffer() wants, so the lexer can scan it
+ * without copying and leave string literals pointing into it. It must
+ * therefore outlive the Story built from it.
+ */
+
+typedef struct SourceBuffer {
+    char *data;
+    size_t len;        // bytes of story text, not counting the terminators
+    size_t map_len;    // length of the mapping, 0 if the text is malloc'd
+} SourceBuffer;
+
+void source_init(SourceBuffer *source);
+
+/* Maps `path` into memory; returns 0 on success, -1 if it cannot be mapped */
+int source_map_file(SourceBuffer *source, const char *path);
+
+/* Reads `stream` to the end; returns 0 on success, -1 on a read error */
+int source_read_stream(SourceBuffer *source, FILE *stream);
+
+/* Copies `len` bytes of `data` */
+void source_copy(SourceBuffer *source, const char *data, size_t len);
+
+void source_release(SourceBuffer *source);
+
+/*
+ * Writes `len` bytes to a fresh file next to `path` and renames it over
+ * `path`, so readers (and mappings) never see a partial file. Returns 0 on
+ * success, -1 on failure.
+ */
+int write_file_atomic(const char *path, const void *data, size_t len);
+
+#endif /* SOURCE_H */
@@ -0,0 +1,49 @@
+#include "stats.h"
+
+#ifdef STORYSCRIPT_STATS
+
+#include <time.h>
+
+_Thread_local StoryStats *story_stats;
+
+double stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void stats_print(const StoryStats *stats, FILE *out) {
+    unsigned long total = 0;
+    for (int i = 0; i < STATS_TOKEN_KINDS; i++) {
+        total += stats->tokens[i];
+    }
+
+    fprintf(out, "\n===== STATS =====\n");
+    fprintf(out, "Bytes read:        %lu\n", stats->bytes_read);
+    fprintf(out, "Tokens:            %lu\n", total);
+    for (int i = 0; i < STATS_TOKEN_KINDS; i++) {
+        if (stats->tokens[i] == 0) continue;
+        fprintf(out, "  %-16s %lu\n",
+                storyscript_token_name(i ? i + 256 : 0), stats->tokens[i]);
+    }
+
+    // Lexing and the actions run inside yyparse(); the rest is the grammar
+    double grammar = stats->parse_time - stats->lex_time - stats->action_time;
+    fprintf(out, "Time (ms):\n");
+    fprintf(out, "  yyparse          %.3f\n", stats->parse_time * 1e3);
+    fprintf(out, "    lexer          %.3f\n", stats->lex_time * 1e3);
+    fprintf(out, "    actions        %.3f\n", stats->action_time * 1e3);
+    fprintf(out, "    grammar        %.3f\n", grammar * 1e3);
+    fprintf(out, "  link             %.3f\n", stats->link_time * 1e3);
+    fprintf(out, "  free_story       %.3f\n", stats->free_time * 1e3);
+
+    fprintf(out, "Symbol lookups:    %lu (%lu key compares)\n",
+            stats->symtab_lookups, stats->symtab_compares);
+    fprintf(out, "Interned names:    %lu (%lu string compares)\n",
+            stats->intern_lookups, stats->intern_compares);
+    fprintf(out, "Arena allocations: %lu (%lu bytes in %lu chunks)\n",
+            stats->arena_allocs, stats->arena_bytes, stats->arena_chunks);
+    fprintf(out, "=================\n");
+}
+
+#endif /* STORYSCRIPT_STATS */
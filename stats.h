@@ -0,0 +1,77 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*
+ * Hot path counters for --stats.
+ *
+ * Only builds with -DSTORYSCRIPT_STATS (make stats) have them. Everywhere
+ * else the STATS_* macros expand to nothing, so the counting code can stay
+ * in the parser at no cost. Counters go to the StoryStats that the current
+ * thread points story_stats at, and are skipped while it is NULL.
+ */
+
+#ifdef STORYSCRIPT_STATS
+
+#include <stdio.h>
+
+#define STATS_TOKEN_KINDS 32   // token number - 256, with 0 for end of input
+
+typedef struct StoryStats {
+    unsigned long tokens[STATS_TOKEN_KINDS];
+    unsigned long bytes_read;
+
+    double lex_time;        // seconds, inside yylex()
+    double parse_time;      // all of yyparse(), actions and lexing included
+    double action_time;     // in the semantic actions
+    double link_time;
+    double free_time;       // in free_story()
+
+    unsigned long symtab_lookups;    // rooms and choices found by name
+    unsigned long symtab_compares;   // keys looked at while probing
+    unsigned long intern_lookups;
+    unsigned long intern_compares;   // memcmp()s on hash matches
+
+    unsigned long arena_allocs;
+    unsigned long arena_bytes;
+    unsigned long arena_chunks;      // malloc()s behind the arena
+} StoryStats;
+
+extern _Thread_local StoryStats *story_stats;
+
+double stats_now(void);
+void stats_print(const StoryStats *stats, FILE *out);
+
+/* Name of a token number, from the grammar */
+const char *storyscript_token_name(int token);
+
+#define STATS_ADD(field, n)                                  \
+    do {                                                     \
+        if (story_stats) story_stats->field += (n);          \
+    } while (0)
+
+#define STATS_TOKEN(token)                                   \
+    do {                                                     \
+        int stats_kind_ = (token) ? (token) - 256 : 0;       \
+        if (story_stats && stats_kind_ >= 0 &&               \
+            stats_kind_ < STATS_TOKEN_KINDS)                 \
+            story_stats->tokens[stats_kind_]++;              \
+    } while (0)
+
+/* Runs the statement and adds the time it took to `field` */
+#define STATS_TIMED(field, ...)                              \
+    do {                                                     \
+        double stats_start_ = story_stats ? stats_now() : 0; \
+        __VA_ARGS__;                                         \
+        if (story_stats)                                     \
+            story_stats->field += stats_now() - stats_start_; \
+    } while (0)
+
+#else
+
+#define STATS_ADD(field, n) ((void)0)
+#define STATS_TOKEN(token) ((void)0)
+#define STATS_TIMED(field, ...) do { __VA_ARGS__; } while (0)
+
+#endif /* STORYSCRIPT_STATS */
+
+#endif /* STATS_H */
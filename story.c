@@ -0,0 +1,697 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash.h"
+#include "stats.h"
+#include "story.h"
+
+/* Implementation of core functions */
+
+Story *init_story() {
+    Story *story = (Story *)malloc(sizeof(Story));
+    if (!story) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    
+    story->title = NULL;
+    story->rooms = NULL;
+    story->items = NULL;
+    story->room_count = 0;
+    story->choice_count = 0;
+    story->option_count = 0;
+    story->item_count = 0;
+    symtab_init(&story->symbols);
+    arena_init(&story->arena);
+    intern_init(&story->names, &story->arena);
+    source_init(&story->source);
+    line_index_init(&story->lines, 0);
+    story->patches = NULL;
+    story->includes = NULL;
+    story->modules = NULL;
+    memset(&story->tables, 0, sizeof(story->tables));
+    return story;
+}
+
+// Rooms by name; while a room is parsed again only the new version of that
+// room can be found, so nothing else in the story is touched
+static Room *find_room(StoryParseCtx *ctx, const char *name) {
+    if (ctx->reparse_target) {
+        return name == ctx->reparse_target->name ? ctx->reparsed : NULL;
+    }
+    return symtab_get(&ctx->story->symbols, NULL, name);
+}
+
+// Messages about a construct name the line and column it starts at
+#define DIAG_AT(ctx, offset, fmt, ...)                                     \
+    do {                                                               \
+        int line_, column_;                                            \
+        story_locate((ctx), (offset), &line_, &column_);               \
+        DIAG(&(ctx)->diag, DIAG_ERROR, "Error at line %d, column %d: " fmt, \
+             line_, column_, __VA_ARGS__);                             \
+    } while (0)
+
+void add_room(StoryParseCtx *ctx, const char *name, const char *description, size_t offset) {
+    Story *story = ctx->story;
+    
+    Room *room = (Room *)arena_alloc(&story->arena, sizeof(Room));
+    room->name = name;
+    room->description = description;
+    room->choices = NULL;
+    room->ending = 0;
+    room->file = NULL;
+    room->text = ctx->text + (ctx->room_start - ctx->text_offset);
+    room->source_start = room->source_end = ctx->room_start;
+    room->line = 0;
+
+    // A re-parsed room is spliced in by storyscript_reparse_room() instead
+    if (ctx->reparse_target) {
+        if (name != ctx->reparse_target->name) {
+            DIAG_AT(ctx, offset, "Expected room '%s', found '%s'\n",
+                    ctx->reparse_target->name, name);
+            ctx->errors++;
+            return;
+        }
+        room->index = ctx->reparse_target->index;
+        room->next = NULL;
+        ctx->reparsed = room;
+        DIAG(&ctx->diag, DIAG_VERBOSE, "Added room: %s\n", name);
+        return;
+    }
+    room->index = story->room_count++;
+    
+    // Add to the front of the list
+    room->next = story->rooms;
+    story->rooms = room;
+    symtab_put(&story->symbols, NULL, room->name, room);
+    
+    DIAG(&ctx->diag, DIAG_VERBOSE, "Added room: %s\n", name);
+}
+
+void add_choice(StoryParseCtx *ctx, const char *room_name, const char *choice_text,
+                size_t offset) {
+    Story *story = ctx->story;
+    
+    // Find the room
+    Room *room = find_room(ctx, room_name);
+    if (!room) {
+        DIAG_AT(ctx, offset, "Room '%s' not found\n", room_name);
+        ctx->errors++;
+        return;
+    }
+    
+    // Create new choice
+    Choice *choice = (Choice *)arena_alloc(&story->arena, sizeof(Choice));
+    choice->text = choice_text;
+    choice->options = NULL;
+    
+    // Add to the front of the list
+    choice->next = room->choices;
+    room->choices = choice;
+    story->choice_count++;
+    symtab_put(&story->symbols, room, choice->text, choice);
+    
+    DIAG(&ctx->diag, DIAG_VERBOSE, "Added choice to room %s: %s\n", room_name, choice_text);
+}
+
+void add_option(StoryParseCtx *ctx, const char *room_name, const char *choice_text, 
+               const char *option_text, const char *target, size_t offset) {
+    Story *story = ctx->story;
+    
+    // Find the room
+    Room *room = find_room(ctx, room_name);
+    if (!room) {
+        DIAG_AT(ctx, offset, "Room '%s' not found\n", room_name);
+        ctx->errors++;
+        return;
+    }
+    
+    // Find the choice
+    Choice *choice = symtab_get(&story->symbols, room, choice_text);
+    if (!choice) {
+        DIAG_AT(ctx, offset, "Choice '%s' not found in room '%s'\n", choice_text, room_name);
+        ctx->errors++;
+        return;
+    }
+    
+    // Create new option
+    Option *option = (Option *)arena_alloc(&story->arena, sizeof(Option));
+    option->text = option_text;
+    option->target_room = target;
+    option->target = NULL;
+    option->offset = (uint32_t)(offset - room->source_start);
+    
+    // Add to the front of the list
+    option->next = choice->options;
+    choice->options = option;
+    story->option_count++;
+    
+    DIAG(&ctx->diag, DIAG_VERBOSE, "Added option to go to %s\n", target);
+}
+
+// Called at the closing brace of a room definition, before any lookahead.
+// A definition without a description made no room of its own, so one
+// found under its name is an earlier definition, which keeps its span.
+void end_room(StoryParseCtx *ctx) {
+    Room *room = find_room(ctx, ctx->current_room);
+    if (!room || room->source_start != ctx->room_start) return;
+
+    room->ending = ctx->room_ending;
+    room->source_end = ctx->brace_end;
+}
+
+void add_include(StoryParseCtx *ctx, const char *path, size_t offset) {
+    Story *story = ctx->story;
+
+    StoryInclude *include = (StoryInclude *)arena_alloc(&story->arena, sizeof(StoryInclude));
+    include->path = path;
+    include->offset = offset;
+
+    // Add to the front of the list
+    include->next = story->includes;
+    story->includes = include;
+
+    DIAG(&ctx->diag, DIAG_VERBOSE, "Added include: %s\n", path);
+}
+
+// Scope of the items in story->symbols, apart from rooms (NULL) and choices (their room)
+static const char item_scope;
+#define ITEM_SCOPE (&item_scope)
+
+void add_item(StoryParseCtx *ctx, const char *name, const char *description, size_t offset) {
+    Story *story = ctx->story;
+
+    // As with rooms, the last definition wins; the item keeps its ID
+    Item *item = symtab_get(&story->symbols, ITEM_SCOPE, name);
+    if (item) {
+        item->description = description;
+        item->offset = offset;
+        DIAG(&ctx->diag, DIAG_VERBOSE, "Redefined item: %s\n", name);
+        return;
+    }
+
+    item = (Item *)arena_alloc(&story->arena, sizeof(Item));
+    item->name = name;
+    item->description = description;
+    item->index = story->item_count++;
+    item->file = NULL;
+    item->offset = offset;
+
+    // Add to the front of the list
+    item->next = story->items;
+    story->items = item;
+    symtab_put(&story->symbols, ITEM_SCOPE, item->name, item);
+
+    DIAG(&ctx->diag, DIAG_VERBOSE, "Added item: %s\n", name);
+}
+
+void story_locate(StoryParseCtx *ctx, size_t offset, int *line, int *column) {
+    // Stream parses record each buffer as it is read instead
+    if (!ctx->lines.built) {
+        line_index_add(&ctx->lines, ctx->text, ctx->text_len, ctx->text_offset);
+        ctx->lines.built = 1;
+    }
+    line_index_locate(&ctx->lines, offset, line, column);
+    *line += ctx->text_line;
+}
+
+int story_line_at(Story *story, size_t offset) {
+    if (!story->lines.built) {
+        line_index_add(&story->lines, story->source.data, story->source.len, 0);
+        story->lines.built = 1;
+    }
+    int line, column;
+    line_index_locate(&story->lines, offset, &line, &column);
+    return line + 1;
+}
+
+int story_room_line(Story *story, Room *room) {
+    if (room->line == 0) {
+        // Rooms of included files are offsets into their own file's text
+        Story *owner = story;
+        for (StoryModule *module = story->modules; room->file && module; module = module->next) {
+            if (module->path == room->file) owner = module->story;
+        }
+        room->line = story_line_at(owner, room->source_start);
+    }
+    return room->line;
+}
+
+void story_merge_module(StoryParseCtx *ctx, Story *module, const char *path) {
+    Story *story = ctx->story;
+    path = arena_strdup(&story->arena, path);
+
+    // Atoms are per story, so names move over to the story's own; every
+    // other string stays in the module's arena
+    Room *last_room = NULL;
+    for (Room *room = module->rooms; room; room = room->next) {
+        room->name = intern_cstring(&story->names, room->name);
+        room->index += story->room_count;
+        room->file = path;
+        for (Choice *choice = room->choices; choice; choice = choice->next) {
+            for (Option *option = choice->options; option; option = option->next) {
+                option->target_room = intern_cstring(&story->names, option->target_room);
+            }
+        }
+
+        // Newest first, so within a file the last definition wins, as it
+        // does in a single file; across files the first one does
+        Room *existing = symtab_get(&story->symbols, NULL, room->name);
+        if (!existing) {
+            symtab_put(&story->symbols, NULL, room->name, room);
+        } else if (existing->file != path) {
+            DIAG(&ctx->diag, DIAG_ERROR, "Error in %s at line %d: Room '%s' is already defined in %s\n",
+                 path, story_room_line(module, room), room->name,
+                 existing->file ? existing->file : ctx->filename);
+            ctx->errors++;
+        }
+        last_room = room;
+    }
+
+    // Items keep dense IDs, so one defined in an earlier file is not
+    // added again; the rest are numbered after the story's
+    Item *items = NULL, *last_item = NULL;
+    unsigned item_count = 0;
+    for (Item *item = module->items, *next; item; item = next) {
+        next = item->next;
+        item->name = intern_cstring(&story->names, item->name);
+        Item *existing = symtab_get(&story->symbols, ITEM_SCOPE, item->name);
+        if (existing) {
+            DIAG(&ctx->diag, DIAG_ERROR, "Error in %s at line %d: Item '%s' is already defined in %s\n",
+                 path, story_line_at(module, item->offset), item->name,
+                 existing->file ? existing->file : ctx->filename);
+            ctx->errors++;
+            continue;
+        }
+        item->file = path;
+        symtab_put(&story->symbols, ITEM_SCOPE, item->name, item);
+        item->next = NULL;
+        if (last_item) last_item->next = item;
+        else items = item;
+        last_item = item;
+        item_count++;
+    }
+    unsigned index = story->item_count + item_count;
+    for (Item *item = items; item; item = item->next) {
+        item->index = --index;
+    }
+
+    // The module's nodes come after the story's, so in front of them in the
+    // newest-first lists
+    if (last_room) {
+        last_room->next = story->rooms;
+        story->rooms = module->rooms;
+    }
+    if (last_item) {
+        last_item->next = story->items;
+        story->items = items;
+    }
+    story->room_count += module->room_count;
+    story->choice_count += module->choice_count;
+    story->option_count += module->option_count;
+    story->item_count += item_count;
+    module->rooms = NULL;
+    module->items = NULL;
+
+    StoryModule *node = (StoryModule *)arena_alloc(&story->arena, sizeof(StoryModule));
+    node->path = path;
+    node->story = module;
+    node->next = story->modules;
+    story->modules = node;
+}
+
+// Options whose goto names no room, gathered to be reported together
+typedef struct Dangling {
+    Room **rooms;
+    const Option **options;
+    size_t count;
+    size_t capacity;
+} Dangling;
+
+static void link_room(const Story *story, Room *room, Dangling *dangling) {
+    for (Choice *choice = room->choices; choice; choice = choice->next) {
+        for (Option *option = choice->options; option; option = option->next) {
+            option->target = symtab_get(&story->symbols, NULL, option->target_room);
+            if (option->target) continue;
+
+            if (dangling->count == dangling->capacity) {
+                dangling->capacity = dangling->capacity ? dangling->capacity * 2 : 16;
+                dangling->rooms = (Room **)realloc(
+                    dangling->rooms, dangling->capacity * sizeof(Room *));
+                dangling->options = (const Option **)realloc(
+                    dangling->options, dangling->capacity * sizeof(Option *));
+                if (!dangling->rooms || !dangling->options) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    exit(1);
+                }
+            }
+            dangling->rooms[dangling->count] = room;
+            dangling->options[dangling->count++] = option;
+        }
+    }
+}
+
+// Options keep their offset into the room's text, which stays put when
+// edits move the room, so their line is counted from the room's
+static int option_line(Story *story, Room *room, const Option *option) {
+    int line = story_room_line(story, room);
+    return room->text ? line + count_lines(room->text, option->offset) : line;
+}
+
+static int report_dangling(StoryParseCtx *ctx, Dangling *dangling) {
+    // The lists are newest first, so this reports in source order
+    for (size_t i = dangling->count; i > 0; i--) {
+        const Option *option = dangling->options[i - 1];
+        Room *room = dangling->rooms[i - 1];
+        int line = option_line(ctx->story, room, option);
+        if (room->file) {
+            DIAG(&ctx->diag, DIAG_ERROR, "Error in %s at line %d: Room '%s' not found\n",
+                 room->file, line, option->target_room);
+        } else {
+            DIAG(&ctx->diag, DIAG_ERROR, "Error at line %d: Room '%s' not found\n",
+                 line, option->target_room);
+        }
+    }
+    ctx->errors += (int)dangling->count;
+
+    free(dangling->rooms);
+    free(dangling->options);
+    return (int)dangling->count;
+}
+
+int story_link(StoryParseCtx *ctx) {
+    Dangling dangling = { NULL, NULL, 0, 0 };
+    for (Room *room = ctx->story->rooms; room; room = room->next) {
+        link_room(ctx->story, room, &dangling);
+    }
+    return report_dangling(ctx, &dangling);
+}
+
+// The tables are rebuilt after edits, so they live outside the arena
+static void *table_alloc(void *table, size_t count, size_t size) {
+    table = realloc(table, (count ? count : 1) * size);
+    if (!table) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return table;
+}
+
+void story_free_tables(StoryTables *t) {
+    free(t->room_name);
+    free(t->room_description);
+    free(t->room_first_choice);
+    free(t->room_first_option);
+    free(t->room_ending);
+    free(t->choice_text);
+    free(t->choice_first_option);
+    free(t->option_text);
+    free(t->option_target_name);
+    free(t->option_target);
+    free(t->item_name);
+    free(t->item_description);
+    free(t->item_slots);
+    memset(t, 0, sizeof(*t));
+}
+
+// Where an item name starts probing in StoryTables.item_slots; images store
+// the slots as they are, so this is part of the image format
+static uint32_t item_hash(const char *name) {
+    return (uint32_t)hash_xxh64(name, strlen(name), 0);
+}
+
+void story_build_tables(Story *story) {
+    StoryTables *t = &story->tables;
+
+    t->room_count = story->room_count;
+    t->choice_count = story->choice_count;
+    t->option_count = story->option_count;
+    t->item_count = story->item_count;
+    t->string_base = 0;
+
+    t->room_name = table_alloc(t->room_name, t->room_count, sizeof(StoryStringRef));
+    t->room_description = table_alloc(t->room_description, t->room_count, sizeof(StoryStringRef));
+    t->room_first_choice = table_alloc(t->room_first_choice, t->room_count + 1, sizeof(uint32_t));
+    t->room_first_option = table_alloc(t->room_first_option, t->room_count + 1, sizeof(uint32_t));
+    t->room_ending = table_alloc(t->room_ending, t->room_count, sizeof(uint8_t));
+    t->choice_text = table_alloc(t->choice_text, t->choice_count, sizeof(StoryStringRef));
+    t->choice_first_option = table_alloc(t->choice_first_option, t->choice_count + 1, sizeof(uint32_t));
+    t->option_text = table_alloc(t->option_text, t->option_count, sizeof(StoryStringRef));
+    t->option_target_name = table_alloc(t->option_target_name, t->option_count, sizeof(StoryStringRef));
+    t->option_target = table_alloc(t->option_target, t->option_count, sizeof(uint32_t));
+    t->item_name = table_alloc(t->item_name, t->item_count, sizeof(StoryStringRef));
+    t->item_description = table_alloc(t->item_description, t->item_count, sizeof(StoryStringRef));
+
+    // Count each room's choices, then turn the counts into range starts
+    memset(t->room_first_choice, 0, (t->room_count + 1) * sizeof(uint32_t));
+    for (const Room *room = story->rooms; room; room = room->next) {
+        uint32_t count = 0;
+        for (const Choice *choice = room->choices; choice; choice = choice->next) {
+            count++;
+        }
+        t->room_first_choice[room->index + 1] = count;
+        t->room_name[room->index] = story_string_ref(room->name);
+        t->room_description[room->index] = story_string_ref(room->description);
+        t->room_ending[room->index] = room->ending ? 1 : 0;
+    }
+    for (uint32_t r = 0; r < t->room_count; r++) {
+        t->room_first_choice[r + 1] += t->room_first_choice[r];
+    }
+
+    // Same for the options of each choice. The lists are newest first, so
+    // every range is filled from its end.
+    memset(t->choice_first_option, 0, (t->choice_count + 1) * sizeof(uint32_t));
+    for (const Room *room = story->rooms; room; room = room->next) {
+        uint32_t c = t->room_first_choice[room->index + 1];
+        for (const Choice *choice = room->choices; choice; choice = choice->next) {
+            uint32_t count = 0;
+            for (const Option *option = choice->options; option; option = option->next) {
+                count++;
+            }
+            t->choice_text[--c] = story_string_ref(choice->text);
+            t->choice_first_option[c + 1] = count;
+        }
+    }
+    for (uint32_t c = 0; c < t->choice_count; c++) {
+        t->choice_first_option[c + 1] += t->choice_first_option[c];
+    }
+    for (uint32_t r = 0; r <= t->room_count; r++) {
+        t->room_first_option[r] = t->choice_first_option[t->room_first_choice[r]];
+    }
+
+    for (const Room *room = story->rooms; room; room = room->next) {
+        uint32_t c = t->room_first_choice[room->index + 1];
+        for (const Choice *choice = room->choices; choice; choice = choice->next) {
+            uint32_t o = t->choice_first_option[--c + 1];
+            for (const Option *option = choice->options; option; option = option->next) {
+                o--;
+                t->option_text[o] = story_string_ref(option->text);
+                t->option_target_name[o] = story_string_ref(option->target_room);
+                t->option_target[o] = option->target ? option->target->index : STORY_NO_ROOM;
+            }
+        }
+    }
+
+    for (const Item *item = story->items; item; item = item->next) {
+        t->item_name[item->index] = story_string_ref(item->name);
+        t->item_description[item->index] = story_string_ref(item->description);
+    }
+
+    // Open addressing with linear probing, at most half full
+    uint32_t slots = 0;
+    if (t->item_count) {
+        for (slots = 2; slots < 2 * t->item_count; slots *= 2) {}
+    }
+    t->item_slot_count = slots;
+    t->item_slots = table_alloc(t->item_slots, slots, sizeof(uint32_t));
+    memset(t->item_slots, 0xff, slots * sizeof(uint32_t));
+    for (uint32_t i = 0; i < t->item_count; i++) {
+        uint32_t s = item_hash(story_string(t, t->item_name[i])) & (slots - 1);
+        while (t->item_slots[s] != STORY_NO_ITEM) s = (s + 1) & (slots - 1);
+        t->item_slots[s] = i;
+    }
+}
+
+uint32_t story_find_item(const StoryTables *t, const char *name) {
+    if (t->item_slot_count == 0) return STORY_NO_ITEM;
+    uint32_t mask = t->item_slot_count - 1;
+    for (uint32_t s = item_hash(name) & mask;; s = (s + 1) & mask) {
+        uint32_t i = t->item_slots[s];
+        if (i == STORY_NO_ITEM || strcmp(story_string(t, t->item_name[i]), name) == 0) return i;
+    }
+}
+
+Room *story_room_at(const Story *story, size_t offset) {
+    for (Room *room = story->rooms; room; room = room->next) {
+        if (!room->file && offset >= room->source_start && offset < room->source_end) {
+            return room;
+        }
+    }
+    return NULL;
+}
+
+static void count_room(const Room *room, unsigned *choices, unsigned *options) {
+    *choices = 0;
+    *options = 0;
+    for (const Choice *choice = room->choices; choice; choice = choice->next) {
+        (*choices)++;
+        for (const Option *option = choice->options; option; option = option->next) {
+            (*options)++;
+        }
+    }
+}
+
+// Rewrites the table entries of a room whose choices and options still
+// fit its old ranges; returns nonzero if the shape changed
+static int patch_room_tables(StoryTables *t, const Room *room) {
+    if (room->index >= t->room_count) return -1;
+    uint32_t first = t->room_first_choice[room->index];
+    uint32_t c = t->room_first_choice[room->index + 1];
+
+    for (const Choice *choice = room->choices; choice; choice = choice->next) {
+        if (c == first) return -1;
+        c--;
+        uint32_t count = 0;
+        for (const Option *option = choice->options; option; option = option->next) {
+            count++;
+        }
+        if (count != t->choice_first_option[c + 1] - t->choice_first_option[c]) return -1;
+    }
+    if (c != first) return -1;
+
+    t->room_description[room->index] = story_string_ref(room->description);
+    t->room_ending[room->index] = room->ending ? 1 : 0;
+    c = t->room_first_choice[room->index + 1];
+    for (const Choice *choice = room->choices; choice; choice = choice->next) {
+        t->choice_text[--c] = story_string_ref(choice->text);
+        uint32_t o = t->choice_first_option[c + 1];
+        for (const Option *option = choice->options; option; option = option->next) {
+            o--;
+            t->option_text[o] = story_string_ref(option->text);
+            t->option_target_name[o] = story_string_ref(option->target_room);
+            t->option_target[o] = option->target ? option->target->index : STORY_NO_ROOM;
+        }
+    }
+    return 0;
+}
+
+void story_discard_room(Story *story, Room *fresh) {
+    for (const Choice *choice = fresh->choices; choice; choice = choice->next) {
+        symtab_remove(&story->symbols, fresh, choice->text);
+    }
+}
+
+void story_splice_room(StoryParseCtx *ctx, Room *room, Room *fresh,
+                       size_t len, int lines) {
+    Story *story = ctx->story;
+    unsigned old_choices, old_options, new_choices, new_options;
+    count_room(room, &old_choices, &old_options);
+    count_room(fresh, &new_choices, &new_options);
+
+    ptrdiff_t shift = (ptrdiff_t)len - (ptrdiff_t)(room->source_end - room->source_start);
+    int line_shift = lines - count_lines(room->text, room->source_end - room->source_start);
+
+    // The choices were filed under `fresh` while it was parsed; move them
+    // to the room in place of its old ones. The list is newest first and
+    // the newest of equal texts wins, as in a full parse.
+    for (const Choice *choice = room->choices; choice; choice = choice->next) {
+        symtab_remove(&story->symbols, room, choice->text);
+    }
+    for (Choice *choice = fresh->choices; choice; choice = choice->next) {
+        symtab_remove(&story->symbols, fresh, choice->text);
+        if (!symtab_get(&story->symbols, room, choice->text)) {
+            symtab_put(&story->symbols, room, choice->text, choice);
+        }
+    }
+
+    // The room keyword stays where it was; its line is taken from the text
+    // it is leaving if nobody has asked for it yet
+    story_room_line(story, room);
+    room->description = fresh->description;
+    room->choices = fresh->choices;
+    room->ending = fresh->ending;
+    room->text = fresh->text;
+    room->source_start = fresh->source_start;
+    room->source_end = fresh->source_end;
+    story->choice_count += new_choices - old_choices;
+    story->option_count += new_options - old_options;
+
+    // Rooms further down the text come before this one in the list
+    for (Room *later = story->rooms; later && later != room; later = later->next) {
+        if (later->file != room->file) continue;
+        story_room_line(story, later);   // while its offset still matches the text
+        later->source_start += shift;
+        later->source_end += shift;
+        later->line += line_shift;
+    }
+
+    // Options elsewhere still point at the same Room, so only these change
+    Dangling dangling = { NULL, NULL, 0, 0 };
+    link_room(story, room, &dangling);
+    report_dangling(ctx, &dangling);
+
+    if (patch_room_tables(&story->tables, room) != 0) {
+        story_build_tables(story);
+    }
+}
+
+// Every node and string lives in the arena, so this is one free per chunk
+static void release_story(Story *story) {
+    for (StoryModule *module = story->modules; module; module = module->next) {
+        release_story(module->story);
+    }
+    for (StoryPatch *patch = story->patches; patch; patch = patch->next) {
+        source_release(&patch->source);
+    }
+    story_free_tables(&story->tables);
+    line_index_free(&story->lines);
+    arena_free(&story->arena);
+    intern_free(&story->names);
+    symtab_free(&story->symbols);
+    source_release(&story->source);
+    free(story);
+}
+
+void free_story(Story *story) {
+    if (!story) return;
+    STATS_TIMED(free_time, release_story(story));
+}
+
+void story_parse_ctx_init(StoryParseCtx *ctx, const char *filename) {
+    ctx->story = NULL;
+    ctx->filename = filename;
+    ctx->current_room = NULL;
+    ctx->current_choice = NULL;
+    ctx->current_item = NULL;
+    ctx->item_description = NULL;
+    ctx->room_ending = 0;
+    ctx->jobs = 0;
+    ctx->module = 0;
+    strbuf_init(&ctx->string_buffer);
+    ctx->string_start = 0;
+    ctx->errors = 0;
+    ctx->max_errors = STORY_MAX_ERRORS;
+    ctx->stopped = 0;
+    ctx->incomplete = 0;
+    diag_init(&ctx->diag, DIAG_NOTE, stdout, stderr);
+    ctx->text = NULL;
+    ctx->text_offset = 0;
+    ctx->text_len = 0;
+    ctx->text_line = 1;
+    line_index_init(&ctx->lines, 0);
+    ctx->room_start = 0;
+    ctx->brace_end = 0;
+    ctx->start_token = 0;
+    ctx->reparse_target = NULL;
+    ctx->reparsed = NULL;
+    ctx->events = NULL;
+    arena_init(&ctx->scratch);
+}
+
+void story_parse_ctx_free(StoryParseCtx *ctx) {
+    // The story belongs to the caller once parsed
+    strbuf_free(&ctx->string_buffer);
+    line_index_free(&ctx->lines);
+    diag_free(&ctx->diag);
+    arena_free(&ctx->scratch);
+}
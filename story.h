@@ -0,0 +1,357 @@
+#ifndef STORY_H
+#define STORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "arena.h"
+#include "diag.h"
+#include "intern.h"
+#include "lines.h"
+#include "source.h"
+#include "strbuf.h"
+#include "symtab.h"
+
+/*
+ * Story data structures shared by the lexer, the grammar and the driver.
+ *
+ * All strings are owned by the story: names (room names, goto targets and
+ * choice texts) are atoms from story->names, string literals are either
+ * slices of story->source or copies in story->arena.
+ *
+ * Positions are byte offsets into the text; lines and columns are only
+ * worked out, from a LineIndex, for the messages that need them.
+ */
+
+/* Byte span of a construct in the story text: the parser's locations */
+typedef struct StoryLoc {
+    size_t start;
+    size_t end;
+} StoryLoc;
+
+typedef struct Room Room;
+
+typedef struct Option {
+    const char *text;
+    const char *target_room;   // atom
+    Room *target;              // set by story_link(), NULL while unresolved
+    uint32_t offset;           // where it was written, from the start of its room's text
+    struct Option *next;
+} Option;
+
+typedef struct Choice {
+    const char *text;          // atom
+    Option *options;
+    struct Choice *next;
+} Choice;
+
+struct Room {
+    const char *name;          // atom
+    const char *description;
+    Choice *choices;
+    unsigned index;            // position in declaration order
+    const char *file;          // included file it was read from, NULL for the main one
+    int ending;                // declared "ending;": may have no way out
+    const char *text;          // its definition, in the source, a patch or a module's source
+    size_t source_start;       // byte span of the whole room definition
+    size_t source_end;
+    int line;                  // of its "room" keyword, 0 until story_room_line()
+    struct Room *next;
+};
+
+typedef struct Item {
+    const char *name;          // atom
+    const char *description;
+    unsigned index;            // position in declaration order: the item's ID
+    const char *file;          // included file it was read from, NULL for the main one
+    size_t offset;             // of its "item" keyword, in that file's text
+    struct Item *next;
+} Item;
+
+/* An include of another file, as written */
+typedef struct StoryInclude {
+    const char *path;
+    size_t offset;
+    struct StoryInclude *next;
+} StoryInclude;
+
+/* An included file, whose rooms and items were merged into the story */
+typedef struct StoryModule {
+    const char *path;          // as opened
+    struct Story *story;       // owns the text, nodes and strings of the file
+    struct StoryModule *next;
+} StoryModule;
+
+#define STORY_NO_ROOM UINT32_MAX   // option whose target does not exist
+#define STORY_NO_ITEM UINT32_MAX   // name that is no item, or an empty slot
+
+#define STORY_MAX_ERRORS 20        // default StoryParseCtx.max_errors
+
+/*
+ * The finished story as structure-of-arrays, in declaration order, built
+ * once parsing is over. Room r owns choices [room_first_choice[r],
+ * room_first_choice[r + 1]) and choice c owns options [choice_first_option[c],
+ * choice_first_option[c + 1]), so whole-story passes walk each array front
+ * to back instead of chasing list nodes.
+ *
+ * Strings are StoryStringRefs, read with story_string(). In a story's
+ * tables they are the addresses of the story's own strings and string_base
+ * is 0; in an image's they are offsets into its string blob, which
+ * string_base points to, so the same arrays can be used in place.
+ */
+typedef uint64_t StoryStringRef;
+
+typedef struct StoryTables {
+    uint32_t room_count;
+    uint32_t choice_count;
+    uint32_t option_count;
+    uint32_t item_count;
+
+    StoryStringRef *room_name;
+    StoryStringRef *room_description;
+    uint32_t *room_first_choice;     // room_count + 1 entries
+    uint32_t *room_first_option;     // room_count + 1: options across the room's choices
+    uint8_t *room_ending;            // 1 for declared endings
+
+    StoryStringRef *choice_text;
+    uint32_t *choice_first_option;   // choice_count + 1 entries
+
+    StoryStringRef *option_text;
+    StoryStringRef *option_target_name;
+    uint32_t *option_target;         // room index, or STORY_NO_ROOM
+
+    StoryStringRef *item_name;
+    StoryStringRef *item_description;
+    uint32_t item_slot_count;        // power of two over twice item_count, 0 without items
+    uint32_t *item_slots;            // item IDs by hash of their name, see story_find_item()
+
+    uintptr_t string_base;           // what the string refs are relative to
+} StoryTables;
+
+static inline const char *story_string(const StoryTables *tables, StoryStringRef ref) {
+    return (const char *)(tables->string_base + (uintptr_t)ref);
+}
+
+static inline StoryStringRef story_string_ref(const char *s) {
+    return (StoryStringRef)(uintptr_t)s;
+}
+
+/* Text of a room that was parsed again, which its strings point into */
+typedef struct StoryPatch {
+    SourceBuffer source;
+    struct StoryPatch *next;
+} StoryPatch;
+
+/*
+ * Callbacks for storyscript_parse_events(), called straight from the
+ * grammar actions in source order; any of them may be NULL. The strings
+ * are only valid until the end of the top-level element (title, item or
+ * room) they belong to, so copy what must be kept.
+ */
+typedef struct StoryEvents {
+    void (*on_title)(void *user, const char *title);
+    void (*on_include)(void *user, const char *path);
+    void (*on_item)(void *user, const char *name, const char *description);
+    void (*on_room)(void *user, const char *name, const char *description);
+    void (*on_ending)(void *user, const char *room);
+    void (*on_choice)(void *user, const char *room, const char *text);
+    void (*on_option)(void *user, const char *room, const char *choice,
+                      const char *text, const char *target);
+    void *user;
+} StoryEvents;
+
+typedef struct Story {
+    const char *title;
+    Room *rooms;
+    Item *items;
+    unsigned room_count;  // nodes in each list
+    unsigned choice_count;
+    unsigned option_count;
+    unsigned item_count;
+    SymTab symbols;       // rooms and items by name, and choices by text within each room
+    InternPool names;     // atoms for identifiers and choice texts
+    Arena arena;          // owns every node and string of the story
+    SourceBuffer source;  // scanned text that string literals point into
+    LineIndex lines;      // newlines of source, recorded when first needed
+    StoryPatch *patches;  // texts of re-parsed rooms, newest first
+    StoryInclude *includes;  // includes of this file, newest first
+    StoryModule *modules; // files pulled in by includes, see story_merge_module()
+    StoryTables tables;   // arrays the output passes use, see story_build_tables()
+} Story;
+
+/*
+ * State of one parse. The lexer and the parser keep everything here (the
+ * ctx doubles as the flex scanner's extra data), so separate contexts can
+ * be used from separate threads at the same time.
+ */
+typedef struct StoryParseCtx {
+    Story *story;                // story being built
+    const char *filename;        // for error reporting
+    const char *current_room;    // atom of the room being parsed
+    const char *current_choice;  // atom of the choice being parsed
+    const char *current_item;    // atom of the item being parsed
+    const char *item_description;  // its description so far, or NULL
+    int room_ending;             // the room being parsed said "ending;"
+    int jobs;                    // threads for included files, 0 for one per CPU
+    int module;                  // parse only (an included file): no link, no tables
+    StrBuf string_buffer;        // lexer accumulator for escaped literals
+    size_t string_start;         // offset of the quote that opened it
+    int errors;                  // number of errors reported so far
+    int max_errors;              // give up after this many, 0 for no limit
+    int stopped;                 // gave up: the rest of the text was not read
+    int incomplete;              // the parser gave up, so nothing was linked
+    DiagSink diag;               // progress and error messages
+    const StoryEvents *events;   // report to these instead of building a story
+    Arena scratch;               // event strings, reset after every element
+
+    // Offsets of the text being scanned, see story_locate()
+    const char *text;            // start of the buffer being scanned
+    size_t text_offset;          // where that buffer starts in the story text
+    size_t text_len;
+    int text_line;               // line that text_offset is on
+    LineIndex lines;             // newlines of the text, for messages
+
+    // Positions the grammar records for end_room()
+    size_t room_start;           // offset of the last "room" keyword
+    size_t brace_end;            // offset just past the last "}"
+    int start_token;             // token to hand the parser first, or 0
+    Room *reparse_target;        // room being parsed again, or NULL
+    Room *reparsed;              // its replacement while that parse runs
+} StoryParseCtx;
+
+/* Story construction; `offset` is where the construct starts, for messages */
+Story *init_story();
+void add_room(StoryParseCtx *ctx, const char *name, const char *description, size_t offset);
+void add_choice(StoryParseCtx *ctx, const char *room_name, const char *choice_text,
+                size_t offset);
+void add_option(StoryParseCtx *ctx, const char *room_name, const char *choice_text,
+               const char *option_text, const char *target, size_t offset);
+void add_item(StoryParseCtx *ctx, const char *name, const char *description, size_t offset);
+void end_room(StoryParseCtx *ctx);
+void add_include(StoryParseCtx *ctx, const char *path, size_t offset);
+
+/*
+ * Line and column of byte `offset` of the text being parsed. Newlines are
+ * indexed on the first call, so parses that report nothing never count them.
+ */
+void story_locate(StoryParseCtx *ctx, size_t offset, int *line, int *column);
+
+/* Line of byte `offset` of the story's own text (not a patch's) */
+int story_line_at(Story *story, size_t offset);
+
+/* Line of the "room" keyword of `room`, worked out once and then kept */
+int story_room_line(Story *story, Room *room);
+
+/*
+ * Moves the rooms and items of `module`, parsed from the included file
+ * `path`, to the end of ctx->story, renaming them into the story's names
+ * so gotos can cross files. Reports rooms defined in both. The story
+ * takes `module` over; links and tables are left to the caller.
+ */
+void story_merge_module(StoryParseCtx *ctx, Story *module, const char *path);
+
+/*
+ * Points every option at the room its goto names and reports each target
+ * that is not a room. Runs once the whole story is parsed, so rooms can be
+ * used before they are declared. Returns the number of dangling targets.
+ */
+int story_link(StoryParseCtx *ctx);
+
+/*
+ * Lays the rooms, choices, options and items out in story->tables. The
+ * parser calls this last; call it again after changing
+ * the lists by hand.
+ */
+void story_build_tables(Story *story);
+
+/*
+ * ID of the item called `name`, or STORY_NO_ITEM: one hash and usually one
+ * string compare, so sessions can test and grant items by name mid-play.
+ * Works on the tables of a story and of an image alike.
+ */
+uint32_t story_find_item(const StoryTables *tables, const char *name);
+
+/* Frees the arrays of `tables` (not the strings) and zeroes it */
+void story_free_tables(StoryTables *tables);
+
+/* The room whose definition covers byte `offset` of the main file's text, or NULL */
+Room *story_room_at(const Story *story, size_t offset);
+
+/*
+ * Moves the freshly parsed `fresh` into `room`, which keeps its identity
+ * so options elsewhere still point at it, then links the room's options
+ * and shifts the positions of the rooms after it. `len` and `lines` are
+ * the size and newline count of the text that replaced the room.
+ */
+void story_splice_room(StoryParseCtx *ctx, Room *room, Room *fresh,
+                       size_t len, int lines);
+
+/* Drops the symbols of a `fresh` room that will not be spliced in */
+void story_discard_room(Story *story, Room *fresh);
+
+void free_story(Story *story);
+
+/*
+ * Parse contexts report notes to stdout and errors to stderr until told
+ * otherwise; per-node progress needs ctx->diag.level = DIAG_VERBOSE.
+ */
+void story_parse_ctx_init(StoryParseCtx *ctx, const char *filename);
+void story_parse_ctx_free(StoryParseCtx *ctx);
+
+/*
+ * Parses `len` bytes of story text into a new story stored in ctx->story
+ * (free it with free_story()). The text is copied first, so `buf` can be
+ * reused as soon as this returns. Returns 0 if the story parsed without
+ * errors.
+ */
+int storyscript_parse(const char *buf, size_t len, StoryParseCtx *ctx);
+
+/*
+ * Same, but scans `source` in place and hands it over to the new story
+ * instead of copying it; `source` is left empty.
+ */
+int storyscript_parse_source(SourceBuffer *source, StoryParseCtx *ctx);
+
+/*
+ * Second half of storyscript_parse_source(), which a parse with
+ * ctx->module set stops short of: loads the included files, links the
+ * gotos and builds the tables. Returns 0 if the whole story parsed
+ * without errors.
+ */
+int storyscript_finish_parse(StoryParseCtx *ctx);
+
+/*
+ * Runs only the lexer over `source` the way storyscript_parse_source()
+ * would, and returns the number of tokens (-1 if the text is too large).
+ * ctx->story holds whatever the lexer allocated. Used by the benchmarks.
+ */
+long storyscript_count_tokens(SourceBuffer *source, StoryParseCtx *ctx);
+
+/*
+ * Incremental update of ctx->story after an edit inside one room: `text`
+ * is the new definition of `room` ("room name { ... }"), replacing the
+ * room's span of the story text. Only that text is scanned and parsed;
+ * the room keeps its identity and its index, its options are linked
+ * again, and the tables are patched in place when the room's shape is
+ * unchanged. `text` must start at the room keyword. Returns 0 on
+ * success. If the text does not parse, or names another room, the story
+ * is left as it was; dangling gotos are reported like in a full parse,
+ * with the room replaced.
+ *
+ * The new text is kept as a StoryPatch until the story is freed, since
+ * the room's strings point into it, and so are the replaced nodes in the
+ * arena. An editor session grows by every version of every edited room;
+ * parse the file again from time to time to drop them.
+ */
+int storyscript_reparse_room(StoryParseCtx *ctx, Room *room, const char *text, size_t len);
+
+/*
+ * Streams the story read from `in` to `events` without building a Story
+ * (ctx->story stays NULL). The text is read through the lexer's buffer
+ * and strings live in a scratch arena that is reset after each element,
+ * so memory use does not grow with the file. Gotos are not resolved.
+ * Returns 0 if the text parsed without errors.
+ */
+int storyscript_parse_events(FILE *in, const StoryEvents *events, StoryParseCtx *ctx);
+
+#endif /* STORY_H */
@@ -0,0 +1,104 @@
+#ifndef STORYSCRIPT_H
+#define STORYSCRIPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Embedding API of libstoryscript (make lib).
+ *
+ * A story is parsed into an opaque StoryScript handle, linked, and then
+ * read with index-based accessors: rooms in declaration order, the
+ * choices of each room and the options of each choice. This header is
+ * all a program needs. The library exports nothing else, and the layout
+ * behind the handle is private, so programs keep working with any later
+ * library of the same STORYSCRIPT_API_VERSION.
+ *
+ * Separate handles can be used from separate threads at once, and a
+ * linked handle can be read from any number of threads. Nothing is
+ * printed: messages are collected in the handle.
+ */
+
+#define STORYSCRIPT_API_VERSION 1
+
+#define STORYSCRIPT_NONE UINT32_MAX   /* no such room or item */
+
+#if defined(__GNUC__)
+#define STORYSCRIPT_API __attribute__((visibility("default")))
+#else
+#define STORYSCRIPT_API
+#endif
+
+typedef struct StoryScript StoryScript;
+
+/* API version of the library loaded, to check against STORYSCRIPT_API_VERSION */
+STORYSCRIPT_API int storyscript_api_version(void);
+
+/* A handle with nothing parsed yet; exits if out of memory */
+STORYSCRIPT_API StoryScript *storyscript_new(void);
+
+STORYSCRIPT_API void storyscript_free(StoryScript *story);
+
+/* Threads for included files, 0 (the default) for one per CPU */
+STORYSCRIPT_API void storyscript_set_jobs(StoryScript *story, int jobs);
+
+/* Errors before the rest of a file is skipped, 0 for no limit (default 20) */
+STORYSCRIPT_API void storyscript_set_max_errors(StoryScript *story, int max_errors);
+
+/*
+ * Parses the story in the file at `path`, or the `len` bytes of `text`
+ * (copied, with `name` used in messages). Includes are read relative to
+ * `path` or `name` when the story is linked. One parse per handle.
+ * Returns the number of errors so far, or -1 if the file cannot be read
+ * or the handle was already used.
+ */
+STORYSCRIPT_API int storyscript_parse_file(StoryScript *story, const char *path);
+STORYSCRIPT_API int storyscript_parse_text(StoryScript *story, const char *text, size_t len,
+                                           const char *name);
+
+/*
+ * Loads the included files and resolves every goto, then lays the story
+ * out for the accessors below, which see an empty story until then.
+ * Returns the number of errors of the whole story (0 for a clean one), or
+ * -1 if nothing was parsed. Linking again does nothing.
+ */
+STORYSCRIPT_API int storyscript_link(StoryScript *story);
+
+/* Errors reported so far */
+STORYSCRIPT_API int storyscript_errors(const StoryScript *story);
+
+/* The error messages, one per line; valid until the next call on the handle */
+STORYSCRIPT_API const char *storyscript_messages(StoryScript *story);
+
+/*
+ * Accessors. Indices count from 0 in declaration order; an index out of
+ * range gives NULL or 0. Strings belong to the handle.
+ */
+STORYSCRIPT_API const char *storyscript_title(const StoryScript *story);
+
+STORYSCRIPT_API uint32_t storyscript_room_count(const StoryScript *story);
+STORYSCRIPT_API const char *storyscript_room_name(const StoryScript *story, uint32_t room);
+STORYSCRIPT_API const char *storyscript_room_description(const StoryScript *story, uint32_t room);
+STORYSCRIPT_API int storyscript_room_is_ending(const StoryScript *story, uint32_t room);
+STORYSCRIPT_API uint32_t storyscript_choice_count(const StoryScript *story, uint32_t room);
+STORYSCRIPT_API const char *storyscript_choice_text(const StoryScript *story, uint32_t room,
+                                                    uint32_t choice);
+STORYSCRIPT_API uint32_t storyscript_option_count(const StoryScript *story, uint32_t room,
+                                                  uint32_t choice);
+STORYSCRIPT_API const char *storyscript_option_text(const StoryScript *story, uint32_t room,
+                                                    uint32_t choice, uint32_t option);
+
+/* Name the option's goto was written with, and the room it leads to or STORYSCRIPT_NONE */
+STORYSCRIPT_API const char *storyscript_option_target_name(const StoryScript *story, uint32_t room,
+                                                           uint32_t choice, uint32_t option);
+STORYSCRIPT_API uint32_t storyscript_option_target(const StoryScript *story, uint32_t room,
+                                                   uint32_t choice, uint32_t option);
+
+STORYSCRIPT_API uint32_t storyscript_item_count(const StoryScript *story);
+STORYSCRIPT_API const char *storyscript_item_name(const StoryScript *story, uint32_t item);
+STORYSCRIPT_API const char *storyscript_item_description(const StoryScript *story, uint32_t item);
+
+/* Index of the item called `name`, or STORYSCRIPT_NONE */
+STORYSCRIPT_API uint32_t storyscript_find_item(const StoryScript *story, const char *name);
+
+#endif /* STORYSCRIPT_H */
@@ -2,103 +2,146 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-// Lexer and parser functions
-extern int yylex();
-extern int yyparse();
-extern FILE *yyin;
-void yyerror(const char *s);
-
-// Access to location information
-extern int yylineno;  // Current line number from our lexer
-extern int column;    // Current column number from our lexer
-extern char *yytext;  // Current token text
-
-/* Simple story data structures */
-typedef struct Option {
-    char *text;
-    char *target_room;
-    struct Option *next;
-} Option;
-
-typedef struct Choice {
-    char *text;
-    Option *options;
-    struct Choice *next;
-} Choice;
-
-typedef struct Room {
-    char *name;
-    char *description;
-    Choice *choices;
-    struct Room *next;
-} Room;
-
-typedef struct Item {
-    char *name;
-    char *description;
-    struct Item *next;
-} Item;
-
-typedef struct Story {
-    char *title;
-    Room *rooms;
-    Item *items;
-} Story;
-
-/* Global state */
-Story *story = NULL;
-char current_room[256];
-char current_choice[256];
-char *current_filename = NULL;  // Track filename for error reporting
-
-/* Function prototypes */
-void init_story();
-void add_room(const char *name, const char *description);
-void add_choice(const char *room_name, const char *choice_text);
-void add_option(const char *room_name, const char *choice_text, 
-               const char *option_text, const char *target);
-void add_item(const char *name, const char *description);
-void print_story();
-void free_story();
 %}
 
+/* Types the generated header needs */
+%code requires {
+#include "stats.h"
+#include "story.h"
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+/* A construct spans from its first token's start to its last token's end */
+#define YYLLOC_DEFAULT(Current, Rhs, N)                                    \
+    do {                                                                   \
+        if (N) {                                                           \
+            (Current).start = YYRHSLOC(Rhs, 1).start;                      \
+            (Current).end = YYRHSLOC(Rhs, N).end;                          \
+        } else {                                                           \
+            (Current).start = (Current).end = YYRHSLOC(Rhs, 0).end;        \
+        }                                                                  \
+    } while (0)
+}
+
+%code {
+// Lexer functions
+int yylex(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner);
+char *yyget_text(yyscan_t scanner);
+void yyerror(YYLTYPE *loc, yyscan_t scanner, StoryParseCtx *ctx, const char *s);
+
+// Event parses call back instead of building the story
+#define EMIT(callback, ...)                                                \
+    do {                                                                   \
+        if (ctx->events->callback)                                         \
+            ctx->events->callback(ctx->events->user, __VA_ARGS__);         \
+    } while (0)
+
+#ifdef STORYSCRIPT_STATS
+// Counts and times every token on its way from the lexer to the parser
+static int stats_lex(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner) {
+    int token;
+    STATS_TIMED(lex_time, token = yylex(yylval, yylloc, scanner));
+    STATS_TOKEN(token);
+    return token;
+}
+#define yylex stats_lex
+#endif
+}
+
+/* Reentrant: all state lives in the scanner and the parse context */
+%define api.pure full
+%define api.location.type {StoryLoc}
+%locations
+%param {yyscan_t scanner}
+%parse-param {StoryParseCtx *ctx}
+
 /* Define value types */
 %union {
-    char *string_val;
+    const char *name;   // interned identifier
+    char *string_val;   // string literal copied into the story arena
 }
 
 /* Define tokens */
 %token STORY TITLE INVENTORY ITEM ROOM DESCRIPTION CHOICE OPTION GOTO
+%token <name> ENDING INCLUDE   /* keywords that can also be names, see identifier */
 %token COLON SEMICOLON LBRACE RBRACE
-%token <string_val> IDENTIFIER STRING_LITERAL
+%token START_ROOM   /* never in the text: makes the parser take a single room */
+%token <name> IDENTIFIER
+%type <name> identifier
+%token <string_val> STRING_LITERAL
 
 %%
 
 /* Grammar rules */
-story_file: story_definition ;
+story_file:
+    story_definition
+    | START_ROOM room_def
+;
 
 story_definition:
     STORY LBRACE story_content RBRACE {
-        printf("Story parsed successfully\n");
+        if (ctx->errors)
+            DIAG(&ctx->diag, DIAG_ERROR, "Story parsed with %d error%s\n",
+                 ctx->errors, ctx->errors == 1 ? "" : "s");
+        else
+            DIAG(&ctx->diag, DIAG_NOTE, "Story parsed successfully\n");
     }
 ;
 
 story_content: 
     /* empty */
-    | story_content story_element 
+    | story_content story_element {
+        if (ctx->events) arena_reset(&ctx->scratch); // element is done
+    }
 ;
 
 story_element:
     title_def
+    | include_def
     | inventory_def
     | room_def
+    | error SEMICOLON { yyerrok; }
+    | error skipped_block { yyerrok; }
+    | error
+;
+
+/*
+ * Error recovery. Each list (story elements, room elements, options) has
+ * an element made of the error token, so a mistake costs only the element
+ * it is in: the parser skips to the end of that statement, over a whole
+ * braced block, or up to the brace that closes the list, then goes on.
+ * The bare alternative is what keeps a closing brace from being skipped.
+ */
+skipped_block:
+    LBRACE skipped_tokens RBRACE
+;
+
+skipped_tokens:
+    /* empty */
+    | skipped_tokens skipped_token
+;
+
+skipped_token:
+    STORY | TITLE | INVENTORY | ITEM | ROOM | DESCRIPTION | CHOICE | OPTION
+    | GOTO | ENDING | INCLUDE | COLON | SEMICOLON | IDENTIFIER | STRING_LITERAL
+    | skipped_block
+;
+
+/* Another file whose rooms and items join this story */
+include_def:
+    INCLUDE STRING_LITERAL SEMICOLON {
+        if (ctx->events) EMIT(on_include, $2);
+        else add_include(ctx, $2, @1.start);
+    }
 ;
 
 title_def:
     TITLE COLON STRING_LITERAL SEMICOLON {
-        if (story == NULL) init_story();
-        story->title = $3;
+        if (ctx->events) EMIT(on_title, $3);
+        else ctx->story->title = $3;
     }
 ;
 
@@ -112,8 +155,18 @@ inventory_items:
 ;
 
 item_def:
-    ITEM IDENTIFIER LBRACE item_properties RBRACE {
-        free($2); // We're done with the identifier
+    ITEM identifier {
+        ctx->current_item = $2;
+        ctx->item_description = NULL;
+    } LBRACE item_properties RBRACE {
+        const char *description = ctx->item_description ? ctx->item_description : "";
+        if (ctx->events) {
+            EMIT(on_item, ctx->current_item, description);
+            arena_reset(&ctx->scratch);
+        } else {
+            STATS_TIMED(action_time, add_item(ctx, ctx->current_item, description, @1.start));
+        }
+        ctx->current_item = NULL;
     }
 ;
 
@@ -124,16 +177,28 @@ item_properties:
 
 item_property:
     DESCRIPTION COLON STRING_LITERAL SEMICOLON {
-        add_item("current_item", $3); // Using placeholder name
+        ctx->item_description = $3; // the last one wins
     }
 ;
 
+/* Names of rooms and items. The keywords added since the first stories
+   were written stay usable as names, which the grammar can always tell
+   apart: a name only ever follows "room", "item" or "goto". */
+identifier:
+    IDENTIFIER
+    | ENDING
+    | INCLUDE
+;
+
 room_def:
-    ROOM IDENTIFIER {
-        strncpy(current_room, $2, sizeof(current_room) - 1);
-        free($2);
+    ROOM identifier {
+        ctx->current_room = $2;
+        ctx->room_ending = 0;
+        ctx->room_start = @1.start;
     } LBRACE room_content RBRACE {
-        current_room[0] = '\0'; // Clear current room
+        ctx->brace_end = @6.end;
+        if (!ctx->events) end_room(ctx);
+        ctx->current_room = NULL; // Clear current room
     }
 ;
 
@@ -145,20 +210,40 @@ room_content:
 room_element:
     room_description
     | choice_def
+    | room_ending
+    | error SEMICOLON { yyerrok; }
+    | error skipped_block { yyerrok; }
+    | error
+;
+
+/* A room the story is meant to stop in, which analysis does not flag */
+room_ending:
+    ENDING SEMICOLON {
+        if (ctx->events) EMIT(on_ending, ctx->current_room);
+        else ctx->room_ending = 1; // the room may not exist until its description
+    }
 ;
 
 room_description:
     DESCRIPTION COLON STRING_LITERAL SEMICOLON {
-        add_room(current_room, $3);
+        if (ctx->events) EMIT(on_room, ctx->current_room, $3);
+        else STATS_TIMED(action_time, add_room(ctx, ctx->current_room, $3, @1.start));
     }
 ;
 
 choice_def:
     CHOICE STRING_LITERAL {
-        strncpy(current_choice, $2, sizeof(current_choice) - 1);
-        add_choice(current_room, $2);
+        if (ctx->events) {
+            ctx->current_choice = $2;
+            EMIT(on_choice, ctx->current_room, $2);
+        } else {
+            STATS_TIMED(action_time, {
+                ctx->current_choice = intern_cstring(&ctx->story->names, $2);
+                add_choice(ctx, ctx->current_room, ctx->current_choice, @1.start);
+            });
+        }
     } LBRACE options RBRACE {
-        current_choice[0] = '\0'; // Clear current choice
+        ctx->current_choice = NULL; // Clear current choice
     }
 ;
 
@@ -168,286 +253,58 @@ options:
 ;
 
 option_def:
-    OPTION STRING_LITERAL GOTO IDENTIFIER SEMICOLON {
-        add_option(current_room, current_choice, $2, $4);
+    OPTION STRING_LITERAL GOTO identifier SEMICOLON {
+        if (ctx->events) EMIT(on_option, ctx->current_room, ctx->current_choice, $2, $4);
+        else STATS_TIMED(action_time, add_option(ctx, ctx->current_room, ctx->current_choice, $2, $4, @1.start));
     }
+    | error SEMICOLON { yyerrok; }
+    | error
 ;
 
 %%
 
-/* Implementation of core functions */
-
-void init_story() {
-    story = (Story *)malloc(sizeof(Story));
-    if (!story) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
-    }
-    
-    story->title = NULL;
-    story->rooms = NULL;
-    story->items = NULL;
-}
-
-void add_room(const char *name, const char *description) {
-    if (!story) init_story();
-    
-    Room *room = (Room *)malloc(sizeof(Room));
-    if (!room) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
-    }
-    
-    room->name = strdup(name);
-    room->description = strdup(description);
-    room->choices = NULL;
-    
-    // Add to the front of the list
-    room->next = story->rooms;
-    story->rooms = room;
-    
-    printf("Added room: %s\n", name);
-}
-
-void add_choice(const char *room_name, const char *choice_text) {
-    if (!story) return;
-    
-    // Find the room
-    Room *room = story->rooms;
-    while (room) {
-        if (strcmp(room->name, room_name) == 0) {
-            // Create new choice
-            Choice *choice = (Choice *)malloc(sizeof(Choice));
-            if (!choice) {
-                fprintf(stderr, "Memory allocation failed\n");
-                exit(1);
-            }
-            
-            choice->text = strdup(choice_text);
-            choice->options = NULL;
-            
-            // Add to the front of the list
-            choice->next = room->choices;
-            room->choices = choice;
-            
-            printf("Added choice to room %s: %s\n", room_name, choice_text);
-            return;
-        }
-        room = room->next;
-    }
-    
-    fprintf(stderr, "Error at line %d, column %d: Room '%s' not found\n", 
-            yylineno, column, room_name);
-}
-
-void add_option(const char *room_name, const char *choice_text, 
-               const char *option_text, const char *target) {
-    if (!story) return;
-    
-    // Find the room
-    Room *room = story->rooms;
-    while (room) {
-        if (strcmp(room->name, room_name) == 0) {
-            // Find the choice
-            Choice *choice = room->choices;
-            while (choice) {
-                if (strcmp(choice->text, choice_text) == 0) {
-                    // Create new option
-                    Option *option = (Option *)malloc(sizeof(Option));
-                    if (!option) {
-                        fprintf(stderr, "Memory allocation failed\n");
-                        exit(1);
-                    }
-                    
-                    option->text = strdup(option_text);
-                    option->target_room = strdup(target);
-                    
-                    // Add to the front of the list
-                    option->next = choice->options;
-                    choice->options = option;
-                    
-                    printf("Added option to go to %s\n", target);
-                    return;
-                }
-                choice = choice->next;
-            }
-            fprintf(stderr, "Error at line %d, column %d: Choice '%s' not found in room '%s'\n", 
-                    yylineno, column, choice_text, room_name);
-            return;
-        }
-        room = room->next;
-    }
-    
-    fprintf(stderr, "Error at line %d, column %d: Room '%s' not found\n", 
-            yylineno, column, room_name);
-}
-
-void add_item(const char *name, const char *description) {
-    if (!story) init_story();
-    
-    Item *item = (Item *)malloc(sizeof(Item));
-    if (!item) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
-    }
-    
-    item->name = strdup(name);
-    item->description = strdup(description);
-    
-    // Add to the front of the list
-    item->next = story->items;
-    story->items = item;
-    
-    printf("Added item: %s\n", name);
-}
-
-void print_story() {
-    if (!story) {
-        printf("No story defined\n");
-        return;
-    }
-    
-    printf("\n===== STORY =====\n");
-    printf("Title: %s\n", story->title ? story->title : "(untitled)");
-    
-    // Print items
-    printf("\n--- ITEMS ---\n");
-    Item *item = story->items;
-    if (!item) {
-        printf("No items defined\n");
-    }
-    while (item) {
-        printf("* %s: %s\n", item->name, item->description);
-        item = item->next;
-    }
-    
-    // Print rooms
-    printf("\n--- ROOMS ---\n");
-    Room *room = story->rooms;
-    if (!room) {
-        printf("No rooms defined\n");
-    }
-    while (room) {
-        printf("\nROOM: %s\n", room->name);
-        printf("Description: %s\n", room->description);
-        
-        // Print choices
-        Choice *choice = room->choices;
-        while (choice) {
-            printf("  Choice: %s\n", choice->text);
-            
-            // Print options
-            Option *option = choice->options;
-            while (option) {
-                printf("    Option: %s -> %s\n", 
-                       option->text, option->target_room);
-                option = option->next;
-            }
-            choice = choice->next;
-        }
-        room = room->next;
-    }
-    
-    printf("\n================\n");
-}
-
-void free_story() {
-    if (!story) return;
-    
-    // Free items
-    Item *item = story->items;
-    while (item) {
-        Item *next_item = item->next;
-        free(item->name);
-        free(item->description);
-        free(item);
-        item = next_item;
-    }
-    
-    // Free rooms
-    Room *room = story->rooms;
-    while (room) {
-        Room *next_room = room->next;
-        
-        // Free room data
-        free(room->name);
-        free(room->description);
-        
-        // Free choices
-        Choice *choice = room->choices;
-        while (choice) {
-            Choice *next_choice = choice->next;
-            
-            // Free choice data
-            free(choice->text);
-            
-            // Free options
-            Option *option = choice->options;
-            while (option) {
-                Option *next_option = option->next;
-                free(option->text);
-                free(option->target_room);
-                free(option);
-                option = next_option;
-            }
-            
-            free(choice);
-            choice = next_choice;
-        }
-        
-        free(room);
-        room = next_room;
-    }
+// Enhanced error reporting function
+void yyerror(YYLTYPE *loc, yyscan_t scanner, StoryParseCtx *ctx, const char *s) {
+    // Past max_errors the lexer ends the text early, which is no mistake
+    if (ctx->stopped) return;
+
+    int line, column;
+    story_locate(ctx, loc->start, &line, &column);
+    DIAG(&ctx->diag, DIAG_ERROR, "Error in %s at line %d, column %d: %s", 
+         ctx->filename ? ctx->filename : "<unknown>", line, column, s);
     
-    // Free story itself
-    free(story->title);
-    free(story);
-    story = NULL;
+    // Print the current token if available
+    const char *text = yyget_text(scanner);
+    if (text && *text)
+        DIAG(&ctx->diag, DIAG_ERROR, " near token '%s'", text);
     
-    // Free filename if allocated
-    if (current_filename) {
-        free(current_filename);
-        current_filename = NULL;
-    }
+    DIAG(&ctx->diag, DIAG_ERROR, "\n");
+    ctx->errors++;
 }
 
-int main(int argc, char **argv) {
-    // Initialize
-    init_story();
-    
-    // Check for input file
-    if (argc > 1) {
-        FILE *input = fopen(argv[1], "r");
-        if (!input) {
-            fprintf(stderr, "Error: Cannot open file '%s'\n", argv[1]);
-            return 1;
-        }
-        yyin = input;
-        current_filename = strdup(argv[1]);
-    } else {
-        printf("Reading from standard input...\n");
-        current_filename = strdup("<stdin>");
+#ifdef STORYSCRIPT_STATS
+const char *storyscript_token_name(int token) {
+    switch (token) {
+        case 0:              return "end of input";
+        case STORY:          return "STORY";
+        case TITLE:          return "TITLE";
+        case INVENTORY:      return "INVENTORY";
+        case ITEM:           return "ITEM";
+        case ROOM:           return "ROOM";
+        case DESCRIPTION:    return "DESCRIPTION";
+        case CHOICE:         return "CHOICE";
+        case OPTION:         return "OPTION";
+        case GOTO:           return "GOTO";
+        case ENDING:         return "ENDING";
+        case INCLUDE:        return "INCLUDE";
+        case START_ROOM:     return "START_ROOM";
+        case COLON:          return "COLON";
+        case SEMICOLON:      return "SEMICOLON";
+        case LBRACE:         return "LBRACE";
+        case RBRACE:         return "RBRACE";
+        case IDENTIFIER:     return "IDENTIFIER";
+        case STRING_LITERAL: return "STRING_LITERAL";
+        default:             return "other";
     }
-    
-    // Parse input
-    yyparse();
-    
-    // Print and cleanup
-    print_story();
-    free_story();
-    
-    return 0;
 }
-
-// Enhanced error reporting function
-void yyerror(const char *s) {
-    fprintf(stderr, "Error in %s at line %d, column %d: %s", 
-            current_filename ? current_filename : "<unknown>",
-            yylineno, column, s);
-    
-    // Print the current token if available
-    if (yytext && *yytext)
-        fprintf(stderr, " near token '%s'", yytext);
-    
-    fprintf(stderr, "\n");
-}
\ No newline at end of file
+#endif
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "strbuf.h"
+
+#define STRBUF_MIN_CAPACITY 256
+
+void strbuf_init(StrBuf *sb) {
+    sb->data = NULL;
+    sb->len = 0;
+    sb->cap = 0;
+}
+
+void strbuf_free(StrBuf *sb) {
+    free(sb->data);
+    strbuf_init(sb);
+}
+
+void strbuf_reserve(StrBuf *sb, size_t extra) {
+    if (sb->cap - sb->len >= extra) return;
+
+    size_t cap = sb->cap ? sb->cap : STRBUF_MIN_CAPACITY;
+    while (cap - sb->len < extra) {
+        cap *= 2;
+    }
+
+    char *data = (char *)realloc(sb->data, cap);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    sb->data = data;
+    sb->cap = cap;
+}
+
+void strbuf_append(StrBuf *sb, const char *s, size_t len) {
+    if (len == 0) return;   // an empty buffer has no data to copy to yet
+    strbuf_reserve(sb, len);
+    memcpy(sb->data + sb->len, s, len);
+    sb->len += len;
+}
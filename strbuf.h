@@ -0,0 +1,36 @@
+#ifndef STRBUF_H
+#define STRBUF_H
+
+#include <stddef.h>
+
+/*
+ * Growable byte buffer. Capacity doubles whenever it runs out, so appending
+ * n bytes in total costs O(n) no matter how it is split up. The contents
+ * are not NUL-terminated.
+ */
+
+typedef struct StrBuf {
+    char *data;
+    size_t len;
+    size_t cap;
+} StrBuf;
+
+void strbuf_init(StrBuf *sb);
+void strbuf_free(StrBuf *sb);
+
+/* Makes room for at least `extra` more bytes */
+void strbuf_reserve(StrBuf *sb, size_t extra);
+
+void strbuf_append(StrBuf *sb, const char *s, size_t len);
+
+static inline void strbuf_putc(StrBuf *sb, char c) {
+    if (sb->len == sb->cap) strbuf_reserve(sb, 1);
+    sb->data[sb->len++] = c;
+}
+
+/* Empties the buffer but keeps its memory for reuse */
+static inline void strbuf_reset(StrBuf *sb) {
+    sb->len = 0;
+}
+
+#endif /* STRBUF_H */
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "stats.h"
+#include "symtab.h"
+
+#define SYMTAB_MIN_CAPACITY 64
+
+// Mixes the two key addresses; the low bits of a pointer carry no entropy
+static unsigned long symtab_hash(const void *scope, const char *name) {
+    uint64_t hash = (uint64_t)(uintptr_t)name * 0x9E3779B97F4A7C15ULL;
+    hash ^= (uint64_t)(uintptr_t)scope * 0xC2B2AE3D27D4EB4FULL;
+    hash ^= hash >> 29;
+    return (unsigned long)hash;
+}
+
+// Finds the slot holding (scope, name), or the empty slot where it belongs
+static SymEntry *symtab_slot(SymEntry *entries, size_t capacity,
+                             const void *scope, const char *name,
+                             unsigned long hash) {
+    size_t mask = capacity - 1;
+    size_t i = hash & mask;
+
+    while (entries[i].name) {
+        SymEntry *entry = &entries[i];
+        STATS_ADD(symtab_compares, 1);
+        if (entry->name == name && entry->scope == scope) {
+            return entry;
+        }
+        i = (i + 1) & mask;
+    }
+    return &entries[i];
+}
+
+static void symtab_grow(SymTab *tab) {
+    size_t capacity = tab->capacity ? tab->capacity * 2 : SYMTAB_MIN_CAPACITY;
+    SymEntry *entries = (SymEntry *)calloc(capacity, sizeof(SymEntry));
+    if (!entries) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    // Reinsert the existing entries; keys are unique so no comparisons needed
+    for (size_t i = 0; i < tab->capacity; i++) {
+        SymEntry *old = &tab->entries[i];
+        if (!old->name) continue;
+
+        size_t j = old->hash & (capacity - 1);
+        while (entries[j].name) {
+            j = (j + 1) & (capacity - 1);
+        }
+        entries[j] = *old;
+    }
+
+    free(tab->entries);
+    tab->entries = entries;
+    tab->capacity = capacity;
+}
+
+void symtab_init(SymTab *tab) {
+    tab->entries = NULL;
+    tab->capacity = 0;
+    tab->count = 0;
+}
+
+void symtab_free(SymTab *tab) {
+    free(tab->entries);
+    symtab_init(tab);
+}
+
+void *symtab_get(const SymTab *tab, const void *scope, const char *name) {
+    STATS_ADD(symtab_lookups, 1);
+    if (tab->count == 0) return NULL;
+
+    SymEntry *entry = symtab_slot(tab->entries, tab->capacity, scope, name,
+                                  symtab_hash(scope, name));
+    return entry->name ? entry->value : NULL;
+}
+
+void symtab_put(SymTab *tab, const void *scope, const char *name, void *value) {
+    // Keep the load factor under 3/4 so probe sequences stay short
+    if ((tab->count + 1) * 4 > tab->capacity * 3) {
+        symtab_grow(tab);
+    }
+
+    unsigned long hash = symtab_hash(scope, name);
+    SymEntry *entry = symtab_slot(tab->entries, tab->capacity, scope, name, hash);
+    if (!entry->name) {
+        entry->scope = scope;
+        entry->name = name;
+        entry->hash = hash;
+        tab->count++;
+    }
+    entry->value = value;
+}
+
+void symtab_remove(SymTab *tab, const void *scope, const char *name) {
+    if (tab->count == 0) return;
+
+    size_t mask = tab->capacity - 1;
+    SymEntry *entry = symtab_slot(tab->entries, tab->capacity, scope, name,
+                                  symtab_hash(scope, name));
+    if (!entry->name) return;
+
+    // Move later entries of the probe run back into the hole, so lookups
+    // never stop at it; an entry only moves if that stays on its own path
+    size_t hole = (size_t)(entry - tab->entries);
+    for (size_t i = (hole + 1) & mask; tab->entries[i].name; i = (i + 1) & mask) {
+        size_t home = tab->entries[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            tab->entries[hole] = tab->entries[i];
+            hole = i;
+        }
+    }
+    tab->entries[hole].name = NULL;
+    tab->count--;
+}
@@ -0,0 +1,43 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include <stddef.h>
+
+/*
+ * Symbol table used by the grammar actions.
+ *
+ * An open-addressing hash table (linear probing, power-of-two capacity)
+ * mapping a (scope, name) pair to a pointer. Rooms are stored with a NULL
+ * scope; choices are stored with their owning Room as scope, which gives
+ * every room its own choice index without a table per room.
+ *
+ * Names are interned atoms (see intern.h), so keys are hashed and compared
+ * by address and no string comparison ever happens here.
+ */
+
+typedef struct SymEntry {
+    const void *scope;
+    const char *name;     // NULL marks an empty slot
+    unsigned long hash;
+    void *value;
+} SymEntry;
+
+typedef struct SymTab {
+    SymEntry *entries;
+    size_t capacity;
+    size_t count;
+} SymTab;
+
+void symtab_init(SymTab *tab);
+void symtab_free(SymTab *tab);
+
+/* Returns the value stored for (scope, name), or NULL if there is none */
+void *symtab_get(const SymTab *tab, const void *scope, const char *name);
+
+/* Inserts or replaces the value stored for (scope, name) */
+void symtab_put(SymTab *tab, const void *scope, const char *name, void *value);
+
+/* Removes the entry for (scope, name), if there is one */
+void symtab_remove(SymTab *tab, const void *scope, const char *name);
+
+#endif /* SYMTAB_H */
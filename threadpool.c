@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "threadpool.h"
+
+// Range of task indices [head, tail) still owned by one worker
+typedef struct WorkQueue {
+    pthread_mutex_t lock;
+    size_t head;
+    size_t tail;
+} WorkQueue;
+
+typedef struct ThreadPool {
+    WorkQueue *queues;
+    int jobs;
+    ThreadPoolTask task;
+    void *arg;
+} ThreadPool;
+
+typedef struct Worker {
+    ThreadPool *pool;
+    int id;
+} Worker;
+
+static int queue_pop(WorkQueue *queue, size_t *index) {
+    int found = 0;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail) {
+        *index = queue->head++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+// Moves the back half of the largest other queue into the worker's own queue
+static int steal(ThreadPool *pool, int self) {
+    int victim = -1;
+    size_t most = 0;
+
+    // Sizes are only a hint here; they are checked again under the lock
+    for (int i = 1; i < pool->jobs; i++) {
+        int j = (self + i) % pool->jobs;
+        pthread_mutex_lock(&pool->queues[j].lock);
+        size_t left = pool->queues[j].tail - pool->queues[j].head;
+        pthread_mutex_unlock(&pool->queues[j].lock);
+        if (left > most) {
+            most = left;
+            victim = j;
+        }
+    }
+    if (victim < 0) return 0;
+
+    WorkQueue *from = &pool->queues[victim];
+    size_t head = 0, tail = 0;
+    pthread_mutex_lock(&from->lock);
+    size_t left = from->tail - from->head;
+    if (left > 0) {
+        size_t take = (left + 1) / 2;
+        tail = from->tail;
+        head = tail - take;
+        from->tail = head;
+    }
+    pthread_mutex_unlock(&from->lock);
+    if (head == tail) return 1;  // lost the race, look again
+
+    WorkQueue *own = &pool->queues[self];
+    pthread_mutex_lock(&own->lock);
+    own->head = head;
+    own->tail = tail;
+    pthread_mutex_unlock(&own->lock);
+    return 1;
+}
+
+static void *worker_main(void *data) {
+    Worker *worker = (Worker *)data;
+    ThreadPool *pool = worker->pool;
+    WorkQueue *own = &pool->queues[worker->id];
+
+    // No new tasks appear once the run starts, so when nothing is left to
+    // steal every task has been claimed and the worker can stop
+    for (;;) {
+        size_t index;
+        while (queue_pop(own, &index)) {
+            pool->task(index, pool->arg);
+        }
+        if (!steal(pool, worker->id)) break;
+    }
+    return NULL;
+}
+
+void threadpool_run(size_t count, int jobs, ThreadPoolTask task, void *arg) {
+    if (jobs < 1) jobs = 1;
+    if ((size_t)jobs > count) jobs = count ? (int)count : 1;
+
+    ThreadPool pool;
+    pool.jobs = jobs;
+    pool.task = task;
+    pool.arg = arg;
+    pool.queues = (WorkQueue *)malloc(jobs * sizeof(WorkQueue));
+    Worker *workers = (Worker *)malloc(jobs * sizeof(Worker));
+    pthread_t *threads = (pthread_t *)malloc(jobs * sizeof(pthread_t));
+    if (!pool.queues || !workers || !threads) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].head = count * i / jobs;
+        pool.queues[i].tail = count * (i + 1) / jobs;
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+
+    // The calling thread works as worker 0
+    for (int i = 1; i < jobs; i++) {
+        if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "Error: Cannot start worker thread\n");
+            exit(1);
+        }
+    }
+    worker_main(&workers[0]);
+    for (int i = 1; i < jobs; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+    free(threads);
+    free(workers);
+    free(pool.queues);
+}
+
+int threadpool_default_jobs() {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
@@ -0,0 +1,23 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+
+/*
+ * Fork-join work-stealing pool for independent tasks numbered 0..count-1.
+ *
+ * Each worker starts with an equal, contiguous slice of the task indices
+ * and takes tasks from the front of it. A worker that runs dry steals the
+ * back half of the busiest-looking other slice, so a few slow tasks (huge
+ * story files) don't leave the other threads idle. Returns once every
+ * task has run. `task` must be safe to call from several threads at once.
+ */
+
+typedef void (*ThreadPoolTask)(size_t index, void *arg);
+
+void threadpool_run(size_t count, int jobs, ThreadPoolTask task, void *arg);
+
+/* Number of CPUs available, at least 1 */
+int threadpool_default_jobs();
+
+#endif /* THREADPOOL_H */